@@ -0,0 +1,222 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "AllocationTracker.h"
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <algorithm>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <Psapi.h>
+#endif
+
+using namespace std;
+
+atomic<bool> AllocationTracker::s_IsEnabled(false);
+atomic<long long> AllocationTracker::s_LiveHeapBytes(0);
+atomic<long long> AllocationTracker::s_PeakLiveHeapBytes(0);
+atomic<unsigned long long> AllocationTracker::s_PeakRssBeforeReset(0);
+
+thread_local AllocationTracker::Counters AllocationTracker::s_Counters = { 0, 0, 0 };
+
+#ifdef TRACK_HEAP_ALLOCATIONS
+
+//Every block starts with the nr of bytes it was tracked with (0 => allocated while tracking was disabled),
+//padded to keep the alignment of malloc
+static const size_t s_HeaderSize = alignof(max_align_t);
+
+//Replacements of the global operator new & delete. All versions are replaced, since every block must carry the header.
+void* operator new(size_t size)
+{
+	void* pBlock = malloc(s_HeaderSize + size);
+	if(!pBlock)
+		throw bad_alloc();
+
+	size_t trackedSize = AllocationTracker::IsEnabled() ? size : 0;
+	*static_cast<size_t*>(pBlock) = trackedSize;
+	if(trackedSize > 0)
+		AllocationTracker::RecordAllocation(trackedSize);
+	return static_cast<char*>(pBlock) + s_HeaderSize;
+}
+
+void operator delete(void* p) noexcept
+{
+	if(!p)
+		return;
+
+	void* pBlock = static_cast<char*>(p) - s_HeaderSize;
+	size_t trackedSize = *static_cast<size_t*>(pBlock);
+	if(trackedSize > 0)
+		AllocationTracker::RecordFree(trackedSize);
+	free(pBlock);
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	try{
+		return operator new(size);
+	}
+	catch(bad_alloc&){
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+//Sized deallocation, the header knows the size already
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+#endif
+
+//Methods
+//*******
+
+void AllocationTracker::Enable(void)
+{
+	if(!TracksHeapAllocations())
+		cout << "Heap allocations aren't tracked by this build (TRACK_HEAP_ALLOCATIONS), only arena bytes & the resident set size are reported.\n";
+
+	s_IsEnabled = true;
+}
+
+AllocationTracker::Counters AllocationTracker::GetThreadCounters(void)
+{
+	return s_Counters;
+}
+
+long long AllocationTracker::GetLiveHeapBytes(void)
+{
+	return s_LiveHeapBytes;
+}
+
+long long AllocationTracker::GetPeakLiveHeapBytes(void)
+{
+	return s_PeakLiveHeapBytes;
+}
+
+void AllocationTracker::RecordAllocation(size_t size)
+{
+	s_Counters.HeapAllocated += size;
+
+	long long live = s_LiveHeapBytes += size;
+	long long peak = s_PeakLiveHeapBytes;
+	while(live > peak && !s_PeakLiveHeapBytes.compare_exchange_weak(peak, live))
+		;
+}
+
+void AllocationTracker::RecordFree(size_t size)
+{
+	s_Counters.HeapFreed += size;
+	s_LiveHeapBytes -= size;
+}
+
+void AllocationTracker::GetResidentSetSize(unsigned long long& current, unsigned long long& peak)
+{
+	current = peak = 0;
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))){
+		current = counters.WorkingSetSize;
+		peak = counters.PeakWorkingSetSize;
+	}
+#else
+	//Lines like "VmRSS:	  123456 kB"
+	ifstream status("/proc/self/status");
+	string line;
+	while(getline(status, line)){
+		if(line.compare(0, 6, "VmRSS:") == 0)
+			current = strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+		else if(line.compare(0, 6, "VmHWM:") == 0)
+			peak = strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+	}
+
+	//The kernel's peak only covers the time since the last reset
+	peak = max(peak, s_PeakRssBeforeReset.load());
+#endif
+}
+
+bool AllocationTracker::ResetRecentPeakResidentSetSize(void)
+{
+#ifdef __linux__
+	//Keep the lifetime peak before the kernel forgets it
+	unsigned long long recentPeak = GetRecentPeakResidentSetSize();
+	unsigned long long peak = s_PeakRssBeforeReset;
+	while(recentPeak > peak && !s_PeakRssBeforeReset.compare_exchange_weak(peak, recentPeak))
+		;
+
+	//Writing 5 resets VmHWM to the current resident set size (Linux 4.0 & later)
+	ofstream clearRefs("/proc/self/clear_refs");
+	clearRefs << "5";
+	clearRefs.close();
+	return !clearRefs.fail();
+#else
+	return false;
+#endif
+}
+
+unsigned long long AllocationTracker::GetRecentPeakResidentSetSize(void)
+{
+	unsigned long long peak = 0;
+
+#ifdef __linux__
+	ifstream status("/proc/self/status");
+	string line;
+	while(getline(status, line))
+		if(line.compare(0, 6, "VmHWM:") == 0)
+			peak = strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+#endif
+	return peak;
+}
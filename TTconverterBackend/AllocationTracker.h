@@ -0,0 +1,90 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+
+// Counts the bytes allocated through operator new & conversion arenas, per thread, once enabled.
+// Stage scopes attribute the difference in the counters of their thread to their stage; memory of the fbx sdk & PhysX only shows up in the resident set size.
+// Heap bytes are only counted in builds that define TRACK_HEAP_ALLOCATIONS, which replace operator new & delete for the whole process:
+// every block then carries a header of alignof(max_align_t) bytes with its tracked size, even while tracking is disabled.
+// Other builds leave the allocator alone and only count arena bytes & the resident set size.
+class AllocationTracker final
+{
+public:
+	struct Counters{
+		unsigned long long HeapAllocated;
+		unsigned long long HeapFreed;
+		unsigned long long ArenaAllocated;
+	};
+
+	static void Enable(void);
+
+	// * Checks if this build counts heap bytes (TRACK_HEAP_ALLOCATIONS).
+	static bool TracksHeapAllocations(void)
+	{
+#ifdef TRACK_HEAP_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	static bool IsEnabled(void)
+	{
+		return s_IsEnabled.load(std::memory_order_relaxed);
+	}
+
+	//Bytes allocated & freed by the calling thread since tracking was enabled
+	static Counters GetThreadCounters(void);
+
+	//Heap bytes allocated & not yet freed since tracking was enabled, and their peak
+	static long long GetLiveHeapBytes(void);
+	static long long GetPeakLiveHeapBytes(void);
+
+	// * Resident set size of the process & its peak over the lifetime of the process, in bytes. Read from /proc/self/status on Linux, 0 where unsupported.
+	static void GetResidentSetSize(unsigned long long& current, unsigned long long& peak);
+
+	// * Restarts the peak of GetRecentPeakResidentSetSize, the lifetime peak is kept. Linux only (/proc/self/clear_refs), returns false elsewhere.
+	static bool ResetRecentPeakResidentSetSize(void);
+	// * Peak resident set size since the last reset by any thread, in bytes.
+	static unsigned long long GetRecentPeakResidentSetSize(void);
+
+	static void RecordAllocation(size_t size);
+	static void RecordFree(size_t size);
+
+	static void RecordArenaAllocation(size_t size)
+	{
+		if(IsEnabled())
+			s_Counters.ArenaAllocated += size;
+	}
+
+private:
+	static std::atomic<bool> s_IsEnabled;
+	static std::atomic<long long> s_LiveHeapBytes;
+	static std::atomic<long long> s_PeakLiveHeapBytes;
+	static std::atomic<unsigned long long> s_PeakRssBeforeReset;
+
+	static thread_local Counters s_Counters;
+
+	//Disabling default constructor, copy constructor & assignment operator
+	AllocationTracker(void);
+	AllocationTracker(const AllocationTracker& src);
+	AllocationTracker& operator=(const AllocationTracker& src);
+};
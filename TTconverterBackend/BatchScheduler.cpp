@@ -0,0 +1,179 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BatchScheduler.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+//Estimated bytes per byte of input for files that were never converted before
+static const double s_DefaultBytesPerFileByte = 24.0;
+
+//The fbx sdk's scene isn't allocated from the arena, its size is estimated from the input size
+static const double s_SceneBytesPerFileByte = 8.0;
+
+//Margin on top of recorded peaks
+static const double s_EstimateMargin = 1.25;
+
+//Size of the scratch files backing the arena of out-of-core jobs
+static const size_t s_ScratchBlockSize = 256 * 1024 * 1024;
+
+static unsigned long long GetFileSize(const string& filename)
+{
+	ifstream file(filename, ios::binary | ios::ate);
+	return file ? static_cast<unsigned long long>(file.tellg()) : 0;
+}
+
+static unsigned long long GetPhysicalMemory(void)
+{
+#ifdef _WIN32
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	GlobalMemoryStatusEx(&status);
+	return status.ullTotalPhys;
+#else
+	return static_cast<unsigned long long>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+#endif
+}
+
+//Constructor & Destructor
+//************************
+
+BatchScheduler::BatchScheduler(size_t memoryBudget, unsigned int maxConcurrentJobs, JobHistory& history):
+	m_History(history), 
+	m_MemoryBudget(memoryBudget), 
+	m_MaxConcurrentJobs(maxConcurrentJobs)
+{
+	if(m_MemoryBudget == 0)
+		m_MemoryBudget = static_cast<size_t>(GetPhysicalMemory() / 4 * 3);
+
+	if(m_MaxConcurrentJobs == 0)
+		m_MaxConcurrentJobs = max(thread::hardware_concurrency(), 1u);
+}
+
+BatchScheduler::~BatchScheduler(void)
+{}
+
+//Methods
+//*******
+
+size_t BatchScheduler::EstimatePeakMemory(const ConversionJob& job) const
+{
+	double fileSize = static_cast<double>(GetFileSize(job.InputFilename));
+	double estimate = 0;
+
+	//Files converted before scale their own recorded peak, other files use the highest ratio seen so far
+	JobRecord record;
+	if(m_History.Find(job.InputFilename, record) && record.PeakBytes > 0 && record.Features.FileSize > 0)
+		estimate = record.PeakBytes * max(1.0, fileSize / record.Features.FileSize);
+	else{
+		double bytesPerFileByte = s_DefaultBytesPerFileByte;
+		for(auto& otherRecord : m_History.GetRecords())
+			if(otherRecord.second.PeakBytes > 0 && otherRecord.second.Features.FileSize > 0)
+				bytesPerFileByte = max(bytesPerFileByte, otherRecord.second.PeakBytes / otherRecord.second.Features.FileSize);
+
+		estimate = fileSize * bytesPerFileByte;
+	}
+
+	//Out-of-core jobs only keep their tables & the fbx scene in memory
+	if(job.OutOfCoreLimit > 0)
+		estimate = min(estimate, job.OutOfCoreLimit + fileSize * s_SceneBytesPerFileByte);
+
+	return static_cast<size_t>(estimate * s_EstimateMargin);
+}
+
+void BatchScheduler::Run(const vector<ConversionJob>& jobs, const function<void(const ConversionJob&)>& convert)
+{
+	vector<size_t> estimates;
+	for(auto& job : jobs)
+		estimates.push_back(EstimatePeakMemory(job));
+
+	mutex schedulerMutex;
+	condition_variable jobFinished;
+	size_t committedMemory = 0;
+	unsigned int nrOfRunningJobs = 0;
+	vector<bool> isStarted(jobs.size(), false);
+	vector<thread> threads;
+
+	auto runJob = [&](unsigned int iJob){
+		auto& job = jobs[iJob];
+		ConversionArena arena(job.OutOfCoreLimit > 0 ? s_ScratchBlockSize : 16 * 1024 * 1024);
+		bool succeeded = true;
+
+		if(job.OutOfCoreLimit > 0)
+			arena.EnableOutOfCore(job.ScratchDirectory, job.OutOfCoreLimit);
+
+		try{
+			ArenaScope arenaScope(&arena);
+			convert(job);
+		}
+		catch(exception& e){
+			lock_guard<mutex> lock(schedulerMutex);
+			cout << "\nConversion of " << job.InputFilename << " failed: " << e.what() << "\n\n";
+			succeeded = false;
+		}
+
+		//Record the peak of this job to improve later estimates (the arena of an out-of-core job lives on disk).
+		//This isn't a measured peak: only the arena's allocations are measured, the fbx scene and other heap allocations
+		//can't be attributed to one of the concurrent jobs and are estimated from the file size instead.
+		double fileSize = static_cast<double>(GetFileSize(job.InputFilename));
+		if(succeeded && job.OutOfCoreLimit == 0)
+			m_History.RecordPeak(job, fileSize, arena.GetBytesAllocated() + fileSize * s_SceneBytesPerFileByte);
+
+		lock_guard<mutex> lock(schedulerMutex);
+		committedMemory -= estimates[iJob];
+		--nrOfRunningJobs;
+		jobFinished.notify_all();
+	};
+
+	//Start the first pending job that fits in the remaining budget, a job that exceeds the budget by itself runs alone
+	unique_lock<mutex> lock(schedulerMutex);
+	for(unsigned int nrOfStartedJobs = 0; nrOfStartedJobs < jobs.size(); ){
+		unsigned int iJob = 0;
+		if(nrOfRunningJobs < m_MaxConcurrentJobs)
+			for(; iJob < jobs.size(); ++iJob)
+				if(!isStarted[iJob] && (nrOfRunningJobs == 0 || committedMemory + estimates[iJob] <= m_MemoryBudget))
+					break;
+		
+		if(nrOfRunningJobs >= m_MaxConcurrentJobs || iJob == jobs.size()){
+			jobFinished.wait(lock);
+			continue;
+		}
+
+		isStarted[iJob] = true;
+		committedMemory += estimates[iJob];
+		++nrOfRunningJobs;
+		++nrOfStartedJobs;
+		threads.emplace_back(runJob, iJob);
+	}
+	lock.unlock();
+
+	for(auto& thread : threads)
+		thread.join();
+}
@@ -0,0 +1,52 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "ConversionJob.h"
+#include "JobHistory.h"
+
+// Runs the jobs of a batch concurrently, as long as their estimated peak memory fits in a budget.
+// Estimates are based on the input file size and the peaks recorded for earlier conversions in the job history.
+// Recorded peaks are the arena's allocations plus an estimate of the fbx scene, not the measured memory usage of the process.
+class BatchScheduler final
+{
+public:
+	// * memoryBudget: max nr of bytes the running jobs may use together (0 => 3/4 of the physical memory)
+	// * maxConcurrentJobs: max nr of jobs running at once (0 => nr of hardware threads)
+	BatchScheduler(size_t memoryBudget, unsigned int maxConcurrentJobs, JobHistory& history);
+	~BatchScheduler(void);
+
+	// * Converts every job by calling convert on a thread of its own, with a fresh arena as current arena.
+	// * Failed jobs are reported and don't stop the batch, the peaks of the others are added to the history.
+	void Run(const std::vector<ConversionJob>& jobs, const std::function<void(const ConversionJob&)>& convert);
+
+	// * Estimated peak nr of bytes needed to convert the job.
+	size_t EstimatePeakMemory(const ConversionJob& job) const;
+
+private:
+	JobHistory& m_History;
+	size_t m_MemoryBudget;
+	unsigned int m_MaxConcurrentJobs;
+
+	//Disabling copy constructor & assignment operator
+	BatchScheduler(const BatchScheduler& src);
+	BatchScheduler& operator=(const BatchScheduler& src);
+};
@@ -0,0 +1,388 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+//Microbenchmarks of the converter's hot kernels, fed with synthetic data at several scales.
+//Every kernel reports its cost per element, and hardware counts per element with --perf (Linux).
+
+//Includes
+//********
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <cstdio>
+#include <cmath>
+
+#include "VertexAttributes.h"
+#include "Deduplicate.h"
+#include "FileOutput.h"
+#include "ConversionArena.h"
+#include "PerfCounters.h"
+
+#include <fbxsdk.h>
+
+using namespace std;
+
+//Nr of elements fed to every kernel, from a small prop to a very large scan
+static const unsigned int s_Scales[] = { 10000, 100000, 1000000 };
+
+//Nr of bones of the skeletons sampled by the animation kernel, every bone is sampled at s_NrOfSamples time stamps
+static const unsigned int s_SkeletonSizes[] = { 16, 64, 256 };
+static const unsigned int s_NrOfSamples = 200;
+
+//Every kernel runs this many times per scale, the fastest run is reported
+static const unsigned int s_NrOfRuns = 5;
+
+//Every element occurs this many times on average in the synthetic attribute data, a typical ratio of corners to unique normals
+static const unsigned int s_DuplicationFactor = 4;
+
+//File written by the output kernels, removed at the end
+static const char* s_TempFilename = "benchmark.tmp";
+
+struct Result{
+	double Seconds;
+	double Counts[PerfCounters::NrOfCounters];
+	bool HasCounts;
+};
+
+//Float3 without axis conversion, written by the default WriteImpl
+struct RawFloat3{
+	float x, y, z;
+};
+
+template<typename State>
+//Times run on a fresh state filled by prepare, keeping the fastest of s_NrOfRuns runs.
+//Every run gets an arena of its own, as the converter does for every job.
+Result Measure(const function<void(State&)>& prepare, const function<void(State&)>& run)
+{
+	Result best = { -1, {}, false };
+
+	for(unsigned int iRun=0; iRun < s_NrOfRuns; ++iRun){
+		ConversionArena arena;
+		ArenaScope arenaScope(&arena);
+		State state;
+		prepare(state);
+
+		PerfCounters::Sample countsBegin, countsEnd;
+		bool hasCounts = PerfCounters::IsEnabled() && PerfCounters::Read(countsBegin);
+
+		auto begin = chrono::steady_clock::now();
+		run(state);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+		hasCounts = hasCounts && PerfCounters::Read(countsEnd);
+		if(best.Seconds >= 0 && seconds >= best.Seconds)
+			continue;
+
+		best.Seconds = seconds;
+		best.HasCounts = hasCounts;
+		if(hasCounts)
+			PerfCounters::GetCounts(countsBegin, countsEnd, best.Counts);
+		else
+			for(auto& count : best.Counts)
+				count = 0;
+	}
+
+	return best;
+}
+
+static void PrintHeader(void)
+{
+	cout << left << setw(24) << "Kernel" << right << setw(12) << "Elements" << setw(12) << "Time (ms)" << setw(14) << "ns/element";
+	if(PerfCounters::IsEnabled())
+		for(unsigned int i=0; i < PerfCounters::NrOfCounters; ++i)
+			cout << setw(16) << string(PerfCounters::GetName(static_cast<PerfCounters::Counter>(i))) + "/elem";
+	cout << "\n";
+}
+
+static void PrintResult(const string& kernel, unsigned int nrOfElements, const Result& result)
+{
+	cout << left << setw(24) << kernel << right << setw(12) << nrOfElements << fixed << setprecision(3)
+		<< setw(12) << result.Seconds * 1e3 << setw(14) << result.Seconds * 1e9 / nrOfElements;
+
+	if(result.HasCounts)
+		for(auto count : result.Counts)
+			cout << setw(16) << count / nrOfElements;
+	cout << "\n";
+}
+
+//Unit vectors with s_DuplicationFactor occurrences of each on average, in random order
+static void GenerateDirections(unsigned int nrOfElements, ArenaVector<Float3>& directions)
+{
+	mt19937 random(nrOfElements);
+	normal_distribution<float> coordinate;
+	vector<Float3> unique(nrOfElements / s_DuplicationFactor + 1);
+	for(auto& dir : unique){
+		FbxVector4 vec(coordinate(random), coordinate(random), coordinate(random), 0);
+		vec.Normalize();
+		ConvertAttribute(vec, dir);
+	}
+
+	uniform_int_distribution<unsigned int> pick(0, unique.size() - 1);
+	directions.resize(nrOfElements);
+	for(auto& dir : directions)
+		dir = unique[pick(random)];
+}
+
+static void GenerateTexCoords(unsigned int nrOfElements, ArenaVector<Float2>& texCoords)
+{
+	mt19937 random(nrOfElements);
+	uniform_real_distribution<float> coordinate(0, 1);
+	vector<Float2> unique(nrOfElements / s_DuplicationFactor + 1);
+	for(auto& texCoord : unique){
+		texCoord.x = coordinate(random);
+		texCoord.y = coordinate(random);
+	}
+
+	uniform_int_distribution<unsigned int> pick(0, unique.size() - 1);
+	texCoords.resize(nrOfElements);
+	for(auto& texCoord : texCoords)
+		texCoord = unique[pick(random)];
+}
+
+//Triangle corners of a grid mesh, every vertex is shared by 6 corners
+static void GenerateCorners(unsigned int nrOfCorners, ArenaVector<Vertex>& corners)
+{
+	const unsigned int gridSize = static_cast<unsigned int>(sqrt(nrOfCorners / 6.0)) + 1;
+	corners.reserve(nrOfCorners);
+
+	for(unsigned int iQuad=0; corners.size() < nrOfCorners; ++iQuad){
+		unsigned int x = iQuad % gridSize, y = iQuad / gridSize;
+		unsigned int quad[] = { y * (gridSize + 1) + x, y * (gridSize + 1) + x + 1, (y + 1) * (gridSize + 1) + x + 1, (y + 1) * (gridSize + 1) + x };
+		unsigned int order[] = { 0, 1, 2, 0, 2, 3 };
+
+		for(unsigned int i=0; i < 6 && corners.size() < nrOfCorners; ++i){
+			unsigned int iVertex = quad[order[i]];
+			Vertex vertex = { iVertex, iVertex, iVertex / 2, iVertex / 2, iVertex / 2, 0, iVertex };
+			corners.push_back(vertex);
+		}
+	}
+}
+
+//Control points skinned to 1 to 8 bones, a quarter of them to more than 4
+static void GenerateBlendInfo(unsigned int nrOfElements, ArenaVector<BlendInfo>& blendInfo)
+{
+	mt19937 random(nrOfElements);
+	uniform_int_distribution<unsigned int> nrOfInfluences(1, 8), bone(0, 127);
+	uniform_real_distribution<float> weight(0, 1);
+
+	blendInfo.resize(nrOfElements);
+	for(auto& elem : blendInfo){
+		unsigned int count = nrOfInfluences(random);
+		for(unsigned int i=0; i < count; ++i){
+			elem.BlendIndices.push_back(bone(random));
+			elem.BlendWeights.push_back(weight(random));
+		}
+	}
+}
+
+//Skinned mesh node with a skeleton of the given size, every bone rotating over s_NrOfSamples frames
+static FbxMesh* CreateSkinnedScene(FbxScene* pScene, unsigned int nrOfBones, vector<FbxNode*>& bones)
+{
+	auto pAnimStack = FbxAnimStack::Create(pScene, "Benchmark");
+	auto pAnimLayer = FbxAnimLayer::Create(pScene, "Base");
+	pAnimStack->AddMember(pAnimLayer);
+	pScene->SetCurrentAnimationStack(pAnimStack);
+
+	auto pMeshNode = FbxNode::Create(pScene, "Mesh");
+	auto pMesh = FbxMesh::Create(pScene, "Mesh");
+	pMeshNode->SetNodeAttribute(pMesh);
+	pScene->GetRootNode()->AddChild(pMeshNode);
+
+	//Bones form a balanced tree, a skeleton of 256 bones is 8 levels deep
+	for(unsigned int iBone=0; iBone < nrOfBones; ++iBone){
+		auto pBone = FbxNode::Create(pScene, ("Bone" + to_string(iBone)).c_str());
+		pBone->LclTranslation.Set(FbxDouble3(0, 1, 0));
+		(iBone == 0 ? pScene->GetRootNode() : bones[(iBone - 1) / 2])->AddChild(pBone);
+		bones.push_back(pBone);
+
+		for(auto component : { FBXSDK_CURVENODE_COMPONENT_X, FBXSDK_CURVENODE_COMPONENT_Z }){
+			auto pCurve = pBone->LclRotation.GetCurve(pAnimLayer, component, true);
+			pCurve->KeyModifyBegin();
+			for(unsigned int frame=0; frame <= s_NrOfSamples; frame += 10){
+				FbxTime time;
+				time.SetFrame(frame);
+				int iKey = pCurve->KeyAdd(time);
+				pCurve->KeySetValue(iKey, static_cast<float>((frame + iBone) % 90));
+				pCurve->KeySetInterpolation(iKey, FbxAnimCurveDef::eInterpolationCubic);
+			}
+			pCurve->KeyModifyEnd();
+		}
+	}
+
+	return pMesh;
+}
+
+//Kernels
+//*******
+
+struct Float3State{
+	VertexAttribute<Float3> Attribute;
+};
+
+struct Float2State{
+	VertexAttribute<Float2> Attribute;
+};
+
+struct WeldState{
+	ArenaVector<Vertex> Corners;
+	ArenaVector<Vertex> VertexBuffer;
+	ArenaVector<unsigned int> IndexBuffer;
+};
+
+struct MeshState{
+	Mesh Target;
+};
+
+struct OutputState{
+	ArenaVector<Float3> Positions;
+	ArenaVector<FbxAMatrix> Transforms;
+};
+
+static void BenchmarkOptimize(unsigned int nrOfElements)
+{
+	//Attributes mapped by polygon vertex without index array, the most common layout of normals
+	PrintResult("Optimize<Float3>", nrOfElements, Measure<Float3State>(
+		[&](Float3State& state){ GenerateDirections(nrOfElements, state.Attribute.data); },
+		[&](Float3State& state){ state.Attribute.Optimize(); }));
+
+	PrintResult("Optimize<Float2>", nrOfElements, Measure<Float2State>(
+		[&](Float2State& state){ GenerateTexCoords(nrOfElements, state.Attribute.data); },
+		[&](Float2State& state){ state.Attribute.Optimize(); }));
+}
+
+static void BenchmarkWelding(unsigned int nrOfElements)
+{
+	//Deduplication of the triangle corners into a vertex buffer, as done by BuildBuffers
+	PrintResult("Weld", nrOfElements, Measure<WeldState>(
+		[&](WeldState& state){ GenerateCorners(nrOfElements, state.Corners); },
+		[&](WeldState& state){ Deduplicate(state.Corners, state.VertexBuffer, state.IndexBuffer); }));
+}
+
+static void BenchmarkBlendInfo(unsigned int nrOfElements)
+{
+	PrintResult("LimitBoneInfluences", nrOfElements, Measure<MeshState>(
+		[&](MeshState& state){ GenerateBlendInfo(nrOfElements, state.Target.BlendInformation.data); },
+		[&](MeshState& state){ state.Target.LimitBoneInfluences(4); }));
+
+	PrintResult("Write<BlendInfo>", nrOfElements, Measure<MeshState>(
+		[&](MeshState& state){ GenerateBlendInfo(nrOfElements, state.Target.BlendInformation.data); },
+		[&](MeshState& state){
+			//Same layout as WriteMesh: nr of influences, indices & weights
+			BinaryWriter oFile(s_TempFilename);
+			for(auto& elem : state.Target.BlendInformation.data){
+				oFile.Write<unsigned int>(elem.BlendIndices.size());
+				for(auto index : elem.BlendIndices)
+					oFile.Write<unsigned int>(index);
+				for(auto weight : elem.BlendWeights)
+					oFile.Write<float>(weight);
+			}
+		}));
+}
+
+static void BenchmarkOutput(unsigned int nrOfElements)
+{
+	auto prepare = [&](OutputState& state){
+		GenerateDirections(nrOfElements, state.Positions);
+		state.Transforms.resize(nrOfElements / 16 + 1, FbxAMatrix(FbxVector4(1,2,3,1), FbxVector4(10,20,30,1), FbxVector4(1,1,1,1)));
+	};
+
+	//Throughput of the writer itself, then the cost of converting to the DirectX axis system on top of it
+	PrintResult("BinaryWriter raw", nrOfElements, Measure<OutputState>(prepare, [&](OutputState& state){
+		BinaryWriter oFile(s_TempFilename);
+		for(auto& elem : state.Positions){
+			RawFloat3 raw = { elem.x, elem.y, elem.z };
+			oFile.Write<RawFloat3>(raw);
+		}
+	}));
+
+	PrintResult("Axis Float3", nrOfElements, Measure<OutputState>(prepare, [&](OutputState& state){
+		BinaryWriter oFile(s_TempFilename);
+		for(auto& elem : state.Positions)
+			oFile.Write<Float3>(elem);
+	}));
+
+	PrintResult("Axis FbxVector4", nrOfElements, Measure<OutputState>(prepare, [&](OutputState& state){
+		BinaryWriter oFile(s_TempFilename);
+		for(auto& elem : state.Positions)
+			oFile.Write<FbxVector4>(FbxVector4(elem.x, elem.y, elem.z, 1));
+	}));
+
+	PrintResult("Axis FbxAMatrix", nrOfElements / 16 + 1, Measure<OutputState>(prepare, [&](OutputState& state){
+		BinaryWriter oFile(s_TempFilename);
+		for(auto& transform : state.Transforms)
+			oFile.Write<FbxAMatrix>(transform);
+	}));
+}
+
+static void BenchmarkAnimationSampling(FbxManager* pManager, unsigned int nrOfBones)
+{
+	auto pScene = FbxScene::Create(pManager, "Benchmark");
+	vector<FbxNode*> bones;
+	auto pMesh = CreateSkinnedScene(pScene, nrOfBones, bones);
+
+	vector<double> times;
+	for(unsigned int frame=0; frame < s_NrOfSamples; ++frame)
+		times.push_back(frame);
+
+	PrintResult("SampleTransforms", nrOfBones * s_NrOfSamples, Measure<MeshState>(
+		[&](MeshState& state){
+			state.Target = Mesh(pMesh);
+			for(auto pBone : bones){
+				Bone bone;
+				bone.Name = pBone->GetName();
+				bone.pFbxNode = pBone;
+				bone.pCluster = nullptr;
+				state.Target.Skeleton.push_back(bone);
+			}
+
+			//Evaluations of earlier runs mustn't be served from the evaluator's cache
+			pScene->GetAnimationEvaluator()->Reset();
+		},
+		[&](MeshState& state){ state.Target.SampleTransforms(times); }));
+
+	pScene->Destroy();
+}
+
+// Entrypoint
+//***********
+int main(int argc, char** argv)
+{
+	for(int i=1; i < argc; ++i)
+		if(string(argv[i]) == "--perf")
+			PerfCounters::Enable();
+
+	PrintHeader();
+
+	for(auto nrOfElements : s_Scales){
+		BenchmarkOptimize(nrOfElements);
+		BenchmarkWelding(nrOfElements);
+		BenchmarkBlendInfo(nrOfElements);
+		BenchmarkOutput(nrOfElements);
+	}
+
+	auto pManager = FbxManager::Create();
+	for(auto nrOfBones : s_SkeletonSizes)
+		BenchmarkAnimationSampling(pManager, nrOfBones);
+	pManager->Destroy();
+
+	remove(s_TempFilename);
+	return 0;
+}
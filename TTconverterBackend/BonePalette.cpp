@@ -0,0 +1,112 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BonePalette.h"
+
+#include <map>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+void SplitBonePalettes(Mesh& mesh, unsigned int paletteSize, ArenaVector<Vertex>& vertexBuffer, ArenaVector<unsigned int>& indexBuffer, ArenaVector<Submesh>& submeshes)
+{
+	const auto& blendInfo = mesh.BlendInformation.data;
+	if(blendInfo.empty())
+		return;
+
+	if(paletteSize == 0 || paletteSize > 256)
+		throw runtime_error("Bone palette size must be between 1 and 256");
+
+	ArenaVector<Vertex> newVertexBuffer;
+	ArenaVector<unsigned int> newIndexBuffer;
+	ArenaVector<Submesh> newSubmeshes;
+	ArenaVector<BlendInfo> newBlendInfo;
+	newIndexBuffer.reserve(indexBuffer.size());
+
+	for(auto& submesh : submeshes){
+		const unsigned int endIndex = submesh.FirstIndex + submesh.IndexCount;
+		unsigned int iIndex = submesh.FirstIndex;
+
+		while(iIndex < endIndex){
+			//Start a new palette, keep adding triangles as long as their bones fit in it
+			Submesh newSubmesh;
+			newSubmesh.MaterialName = submesh.MaterialName;
+			newSubmesh.FirstIndex = newIndexBuffer.size();
+			newSubmesh.IndexCount = 0;
+
+			auto& palette = newSubmesh.BonePalette;
+			map<unsigned int, unsigned int> newVertexPerOldVertex;
+			map<unsigned int, unsigned int> newBlendInfoPerOldBlendInfo;
+			ArenaVector<unsigned int> newBones;
+
+			for(; iIndex < endIndex; iIndex += 3){
+				//Gather the bones of this triangle that aren't in the palette yet
+				newBones.clear();
+				for(unsigned int i = iIndex; i < iIndex + 3; ++i)
+					for(auto bone : blendInfo[vertexBuffer[indexBuffer[i]].iAnimData].BlendIndices)
+						if(find(palette.begin(), palette.end(), bone) == palette.end() && find(newBones.begin(), newBones.end(), bone) == newBones.end())
+							newBones.push_back(bone);
+
+				if(palette.size() + newBones.size() > paletteSize){
+					if(palette.empty())
+						throw runtime_error("Bone palette size is too small to fit the bones of a single triangle");
+					break;
+				}
+
+				palette.insert(palette.end(), newBones.begin(), newBones.end());
+
+				for(unsigned int i = iIndex; i < iIndex + 3; ++i){
+					auto it = newVertexPerOldVertex.find(indexBuffer[i]);
+
+					//First use of this vertex in the palette => copy it, referring to palette-local blend indices
+					if(it == newVertexPerOldVertex.end()){
+						Vertex newVert = vertexBuffer[indexBuffer[i]];
+
+						auto itBlend = newBlendInfoPerOldBlendInfo.find(newVert.iAnimData);
+						if(itBlend == newBlendInfoPerOldBlendInfo.end()){
+							BlendInfo localBlendInfo = blendInfo[newVert.iAnimData];
+							for(auto& bone : localBlendInfo.BlendIndices)
+								bone = find(palette.begin(), palette.end(), bone) - palette.begin();
+
+							newBlendInfo.push_back(move(localBlendInfo));
+							itBlend = newBlendInfoPerOldBlendInfo.insert(make_pair(newVert.iAnimData, newBlendInfo.size() - 1)).first;
+						}
+
+						newVert.iAnimData = itBlend->second;
+						newVertexBuffer.push_back(newVert);
+						it = newVertexPerOldVertex.insert(make_pair(indexBuffer[i], newVertexBuffer.size() - 1)).first;
+					}
+
+					newIndexBuffer.push_back(it->second);
+				}
+
+				newSubmesh.IndexCount += 3;
+			}
+
+			newSubmeshes.push_back(move(newSubmesh));
+		}
+	}
+
+	//Blend information is now stored per palette, the per-corner indices no longer apply
+	mesh.BlendInformation.data = move(newBlendInfo);
+	mesh.BlendInformation.indices.clear();
+
+	vertexBuffer = move(newVertexBuffer);
+	indexBuffer = move(newIndexBuffer);
+	submeshes = move(newSubmeshes);
+}
@@ -0,0 +1,27 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include "VertexAttributes.h"
+
+// * Splits the submeshes of a skinned mesh into draw ranges that reference at most paletteSize bones each.
+// * Vertices shared by ranges with different palettes are duplicated, blend indices are remapped to palette-local indices.
+// * Replaces the mesh's blend information, the vertex buffer, index buffer and submeshes. Static meshes are left untouched.
+// * Throws exception when a single triangle references more bones than fit in a palette.
+void SplitBonePalettes(Mesh& mesh, unsigned int paletteSize, ArenaVector<Vertex>& vertexBuffer, ArenaVector<unsigned int>& indexBuffer, ArenaVector<Submesh>& submeshes);
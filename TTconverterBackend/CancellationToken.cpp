@@ -0,0 +1,77 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "CancellationToken.h"
+
+#include <string>
+#include <sstream>
+
+using namespace std;
+
+thread_local CancellationToken* CancellationToken::s_pCurrent = nullptr;
+
+//Constructor & Destructor
+//************************
+
+CancellationToken::CancellationToken(double timeLimit):
+	m_IsCancelled(false),
+	m_TimeLimit(timeLimit),
+	m_Deadline(chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(timeLimit)))
+{}
+
+CancellationToken::~CancellationToken(void)
+{}
+
+CancellationScope::CancellationScope(CancellationToken* pToken):m_pPrevious(CancellationToken::s_pCurrent)
+{
+	CancellationToken::s_pCurrent = pToken;
+}
+
+CancellationScope::~CancellationScope(void)
+{
+	CancellationToken::s_pCurrent = m_pPrevious;
+}
+
+//Methods
+//*******
+
+bool CancellationToken::IsCancelled(void) const
+{
+	if(m_IsCancelled)
+		return true;
+
+	if(m_TimeLimit > 0 && chrono::steady_clock::now() >= m_Deadline)
+		m_IsCancelled = true;
+
+	return m_IsCancelled;
+}
+
+void CancellationToken::Check(void)
+{
+	auto pToken = s_pCurrent;
+	if(!pToken || !pToken->IsCancelled())
+		return;
+
+	ostringstream message;
+	message << "Exceeded the time limit of " << pToken->m_TimeLimit << " seconds";
+	throw JobCancelled(message.str());
+}
+
+CancellationToken* CancellationToken::GetCurrent(void)
+{
+	return s_pCurrent;
+}
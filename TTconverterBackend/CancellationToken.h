@@ -0,0 +1,79 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+// Thrown by CancellationToken::Check once the job of the calling thread is cancelled
+class JobCancelled final : public std::runtime_error
+{
+public:
+	JobCancelled(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Cancels a conversion job when its time limit runs out.
+// The long loops of a conversion call CancellationToken::Check(), which throws JobCancelled once the token of the calling thread is cancelled.
+class CancellationToken final
+{
+public:
+	// * timeLimit: nr of seconds the job may take from now on (0 => no limit)
+	CancellationToken(double timeLimit = 0);
+	~CancellationToken(void);
+
+	// * Thread-safe.
+	bool IsCancelled(void) const;
+
+	// * Throws JobCancelled if the token of the calling thread is cancelled. Reads the clock, call it once per chunk of work.
+	static void Check(void);
+
+	//Token checked by the calling thread (nullptr => never cancelled)
+	static CancellationToken* GetCurrent(void);
+
+private:
+	friend class CancellationScope;
+
+	mutable std::atomic<bool> m_IsCancelled;
+	double m_TimeLimit;
+	std::chrono::steady_clock::time_point m_Deadline;
+
+	static thread_local CancellationToken* s_pCurrent;
+
+	//Disabling copy constructor & assignment operator
+	CancellationToken(const CancellationToken& src);
+	CancellationToken& operator=(const CancellationToken& src);
+};
+
+// Makes a token the one checked by the calling thread for the lifetime of the scope
+class CancellationScope final
+{
+public:
+	CancellationScope(CancellationToken* pToken);
+	~CancellationScope(void);
+
+private:
+	CancellationToken* m_pPrevious;
+
+	//Disabling copy constructor & assignment operator
+	CancellationScope(const CancellationScope& src);
+	CancellationScope& operator=(const CancellationScope& src);
+};
+
+//Loops over individual elements check for cancellation once every this many iterations
+const unsigned int CancellationCheckInterval = 64 * 1024;
@@ -0,0 +1,55 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ContentHash.h"
+
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+//Methods
+//*******
+
+bool ContentHash::UpdateWithFile(const string& filename)
+{
+	ifstream file(filename, ios::binary);
+	if(!file)
+		return false;
+
+	vector<char> buffer(1 << 20);
+	while(file){
+		file.read(buffer.data(), buffer.size());
+		Update(buffer.data(), static_cast<size_t>(file.gcount()));
+	}
+
+	return file.eof();
+}
+
+string ContentHash::ToString(unsigned long long hash)
+{
+	char str[17];
+	snprintf(str, sizeof(str), "%016llx", hash);
+	return str;
+}
+
+unsigned long long ContentHash::FromString(const string& str)
+{
+	return strtoull(str.c_str(), nullptr, 16);
+}
@@ -0,0 +1,79 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+
+// Streaming 64 bit FNV-1a hash, used to detect changes in input files, settings & outputs
+class ContentHash final
+{
+public:
+	// * Hashes with another offset basis are independent of the standard one
+	explicit ContentHash(unsigned long long offsetBasis = 14695981039346656037ull) : m_Hash(offsetBasis) {}
+
+	void Update(const void* pData, size_t size)
+	{
+		const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+		for(size_t i=0; i < size; ++i)
+			m_Hash = (m_Hash ^ pBytes[i]) * 1099511628211ull;
+	}
+
+	void Update(const std::string& str)
+	{
+		Update<unsigned int>(static_cast<unsigned int>(str.size()));
+		Update(str.data(), str.size());
+	}
+
+	template<typename T>
+	void Update(const T& val){ Update(&val, sizeof(T)); }
+
+	// * Hashes the contents of a file, returns false if it can't be read.
+	bool UpdateWithFile(const std::string& filename);
+
+	unsigned long long Get(void) const { return m_Hash; }
+
+	// * 16 digit hexadecimal representation of a hash.
+	static std::string ToString(unsigned long long hash);
+	static unsigned long long FromString(const std::string& str);
+
+private:
+	unsigned long long m_Hash;
+};
+
+// Pair of independently seeded ContentHashes over the same data, for keys that can't be verified against the data they stand for
+class WideContentHash final
+{
+public:
+	WideContentHash(void) : m_Check(0x6c62272e07bb0142ull) {}
+
+	void Update(const void* pData, size_t size)
+	{
+		m_Hash.Update(pData, size);
+		m_Check.Update(pData, size);
+	}
+
+	template<typename T>
+	void Update(const T& val){ Update(&val, sizeof(T)); }
+
+	// * 32 digit hexadecimal representation of both hashes.
+	std::string ToString(void) const { return ContentHash::ToString(m_Hash.Get()) + ContentHash::ToString(m_Check.Get()); }
+
+private:
+	ContentHash m_Hash;
+	ContentHash m_Check;
+};
@@ -0,0 +1,151 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ContentStore.h"
+#include "ContentHash.h"
+#include "ScratchFile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+//Copy a file through a temporary file in the destination's directory, so that the destination never exists half-written
+static bool CopyThroughTempFile(const string& srcFilename, const string& dstFilename)
+{
+	string tmpFilename = ScratchFile::GetTempFilename(dstFilename);
+	bool succeeded = false;
+	{
+		ifstream src(srcFilename, ios::binary);
+		ofstream dst(tmpFilename, ios::binary);
+		if(src && dst){
+			dst << src.rdbuf();
+			succeeded = src && dst.flush();
+		}
+	}
+
+	//Renaming fails if another job stored the same object in the meantime, which is just as good
+	if(!succeeded || rename(tmpFilename.c_str(), dstFilename.c_str()) != 0){
+		remove(tmpFilename.c_str());
+		return succeeded && ifstream(dstFilename).good();
+	}
+
+	return true;
+}
+
+//Hard link newFilename to an existing file, copying it if linking isn't possible (e.g. across volumes)
+static bool LinkOrCopy(const string& existingFilename, const string& newFilename)
+{
+#ifdef _WIN32
+	if(CreateHardLinkA(newFilename.c_str(), existingFilename.c_str(), nullptr))
+		return true;
+#else
+	if(link(existingFilename.c_str(), newFilename.c_str()) == 0)
+		return true;
+#endif
+
+	return CopyThroughTempFile(existingFilename, newFilename);
+}
+
+//Check if two files have the same size and bytes
+static bool HaveSameContents(const string& lhsFilename, const string& rhsFilename)
+{
+	ifstream lhs(lhsFilename, ios::binary | ios::ate), rhs(rhsFilename, ios::binary | ios::ate);
+	if(!lhs || !rhs || lhs.tellg() != rhs.tellg())
+		return false;
+
+	lhs.seekg(0);
+	rhs.seekg(0);
+	vector<char> lhsBuffer(1 << 16), rhsBuffer(1 << 16);
+	while(lhs && rhs){
+		lhs.read(lhsBuffer.data(), lhsBuffer.size());
+		rhs.read(rhsBuffer.data(), rhsBuffer.size());
+		if(lhs.gcount() != rhs.gcount() || !equal(lhsBuffer.begin(), lhsBuffer.begin() + static_cast<size_t>(lhs.gcount()), rhsBuffer.begin()))
+			return false;
+	}
+
+	return lhs.eof() && rhs.eof();
+}
+
+//Constructor & Destructor
+//************************
+
+ContentStore::ContentStore(const string& directory):m_Directory(directory)
+{}
+
+ContentStore::~ContentStore(void)
+{}
+
+//Methods
+//*******
+
+string ContentStore::GetObjectFilename(const string& key) const
+{
+	return m_Directory + "/" + key + ".obj";
+}
+
+bool ContentStore::Deduplicate(const string& filename) const
+{
+	if(!IsEnabled())
+		return false;
+
+	ContentHash hash;
+	if(!hash.UpdateWithFile(filename))
+		return false;
+
+	//Objects with the same hash but other bytes are left alone, the file then simply isn't deduplicated
+	string key = ContentHash::ToString(hash.Get());
+	string objectFilename = GetObjectFilename(key);
+	if(ifstream(objectFilename))
+		return HaveSameContents(objectFilename, filename) && Retrieve(key, filename);
+
+	Store(key, filename);
+	return false;
+}
+
+bool ContentStore::Retrieve(const string& key, const string& filename) const
+{
+	if(!IsEnabled())
+		return false;
+
+	string objectFilename = GetObjectFilename(key);
+	if(!ifstream(objectFilename))
+		return false;
+
+	remove(filename.c_str());
+	return LinkOrCopy(objectFilename, filename);
+}
+
+void ContentStore::Store(const string& key, const string& filename) const
+{
+	if(!IsEnabled())
+		return;
+
+	//Objects are never overwritten, a concurrent job may have stored the same content already.
+	//Linking is atomic and copies only appear under the object's name once complete, so Retrieve never sees a partial object.
+	string objectFilename = GetObjectFilename(key);
+	if(!ifstream(objectFilename))
+		LinkOrCopy(filename, objectFilename);
+}
@@ -0,0 +1,53 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+
+// Content-addressed store of output files, shared by every file of a batch (and by later batches).
+// Identical outputs are hard-linked to a single stored object, so they take up disk space only once.
+// Whole files are deduplicated: outputs that share their geometry but differ in anything else (e.g. their clips) are stored separately.
+class ContentStore final
+{
+public:
+	// * Empty directory => the store is disabled.
+	ContentStore(const std::string& directory);
+	~ContentStore(void);
+
+	bool IsEnabled(void) const { return !m_Directory.empty(); }
+
+	// * Replaces the file by a link to a stored object with the same bytes, or adds it to the store.
+	// * Returns true if an identical object was stored already.
+	bool Deduplicate(const std::string& filename) const;
+
+	// * Links the object stored under key to filename, returns false if there is none.
+	// * The object isn't compared with anything, key has to identify the content on its own (see WideContentHash).
+	bool Retrieve(const std::string& key, const std::string& filename) const;
+
+	// * Stores the file under key. Objects appear in the store only once they're complete.
+	void Store(const std::string& key, const std::string& filename) const;
+
+private:
+	std::string m_Directory;
+
+	std::string GetObjectFilename(const std::string& key) const;
+
+	//Disabling copy constructor & assignment operator
+	ContentStore(const ContentStore& src);
+	ContentStore& operator=(const ContentStore& src);
+};
@@ -0,0 +1,175 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ConversionArena.h"
+#include "ScratchFile.h"
+#include "AllocationTracker.h"
+
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+thread_local ConversionArena* ConversionArena::s_pCurrent = nullptr;
+
+//Constructor & Destructor
+//************************
+
+ConversionArena::ConversionArena(size_t blockSize):m_BlockSize(blockSize), m_BytesReserved(0), m_BytesAllocated(0), m_WorkingSetLimit(0), m_IsOutOfCore(false)
+{}
+
+ConversionArena::~ConversionArena(void)
+{
+	for(auto& block : m_Blocks)
+		DestroyBlock(block);
+}
+
+//Methods
+//*******
+
+void ConversionArena::EnableOutOfCore(const string& scratchDirectory, size_t workingSetLimit)
+{
+	lock_guard<mutex> lock(m_Mutex);
+	m_ScratchDirectory = scratchDirectory;
+	m_WorkingSetLimit = workingSetLimit;
+	m_IsOutOfCore = true;
+}
+
+void* ConversionArena::Allocate(size_t size, size_t alignment)
+{
+	AllocationTracker::RecordArenaAllocation(size);
+	lock_guard<mutex> lock(m_Mutex);
+
+	//Try to fit the allocation in the current block
+	if(!m_Blocks.empty()){
+		auto& block = m_Blocks.back();
+		size_t offset = (reinterpret_cast<size_t>(block.pData) + block.Used + alignment - 1) / alignment * alignment - reinterpret_cast<size_t>(block.pData);
+		
+		if(offset + size <= block.Size){
+			m_BytesAllocated += offset + size - block.Used;
+			block.Used = offset + size;
+			return block.pData + offset;
+		}
+	}
+
+	//Scratch blocks that are filled up leave the working set, otherwise every block of an out-of-core job stays resident
+	if(m_IsOutOfCore && m_BytesReserved > m_WorkingSetLimit)
+		for(auto& block : m_Blocks)
+			if(block.pFile)
+				block.pFile->Evict();
+
+	//Start a new block, large allocations get a block of their own
+	Block newBlock = CreateBlock(max(m_BlockSize, size + alignment));
+	newBlock.Used = newBlock.Size;
+
+	m_BytesReserved += newBlock.Size;
+	m_BytesAllocated += size;
+	
+	char* pOut = reinterpret_cast<char*>((reinterpret_cast<size_t>(newBlock.pData) + alignment - 1) / alignment * alignment);
+
+	//Dedicated blocks are inserted before the current block, so small allocations keep filling the latter
+	if(size + alignment > m_BlockSize && !m_Blocks.empty()){
+		m_Blocks.insert(m_Blocks.end() - 1, newBlock);
+		return pOut;
+	}
+
+	newBlock.Used = pOut - newBlock.pData + size;
+	m_Blocks.push_back(newBlock);
+	return pOut;
+}
+
+void ConversionArena::Reset(void)
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	if(m_Blocks.empty())
+		return;
+
+	//Keep a single block of the default size, release the others.
+	//Dedicated blocks of huge allocations are always released, a long-lived arena would otherwise pin the worst peak it ever saw.
+	auto itKept = find_if(m_Blocks.begin(), m_Blocks.end(), [this](const Block& block){
+		return block.Size <= m_BlockSize;
+	});
+
+	for(auto it = m_Blocks.begin(); it != m_Blocks.end(); ++it)
+		if(it != itKept)
+			DestroyBlock(*it);
+
+	if(itKept == m_Blocks.end()){
+		m_Blocks.clear();
+		m_BytesReserved = 0;
+	}
+	else{
+		Block kept = *itKept;
+		kept.Used = 0;
+		m_Blocks.assign(1, kept);
+		m_BytesReserved = kept.Size;
+	}
+	m_BytesAllocated = 0;
+}
+
+size_t ConversionArena::GetBytesReserved(void) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+	return m_BytesReserved;
+}
+
+size_t ConversionArena::GetBytesAllocated(void) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+	return m_BytesAllocated;
+}
+
+ConversionArena::Block ConversionArena::CreateBlock(size_t size)
+{
+	Block newBlock;
+	newBlock.Size = size;
+	newBlock.Used = 0;
+	newBlock.pFile = m_IsOutOfCore ? new ScratchFile(m_ScratchDirectory, size) : nullptr;
+	newBlock.pData = newBlock.pFile ? newBlock.pFile->GetData() : static_cast<char*>(malloc(size));
+	
+	if(!newBlock.pData)
+		throw bad_alloc();
+
+	return newBlock;
+}
+
+void ConversionArena::DestroyBlock(Block& block)
+{
+	if(block.pFile)
+		delete block.pFile;
+	else
+		free(block.pData);
+}
+
+ConversionArena* ConversionArena::GetCurrent(void)
+{
+	return s_pCurrent;
+}
+
+//ArenaScope
+//**********
+
+ArenaScope::ArenaScope(ConversionArena* pArena):m_pPrevious(ConversionArena::s_pCurrent)
+{
+	ConversionArena::s_pCurrent = pArena;
+}
+
+ArenaScope::~ArenaScope(void)
+{
+	ConversionArena::s_pCurrent = m_pPrevious;
+}
@@ -0,0 +1,147 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+class ScratchFile;
+
+// Monotonic allocator for the intermediate buffers of a conversion job.
+// Memory is handed out from large blocks and only released all at once by Reset(), so a batch 
+// reuses the same memory for every file instead of going through malloc for each container.
+class ConversionArena final
+{
+public:
+	ConversionArena(size_t blockSize = 16 * 1024 * 1024);
+	~ConversionArena(void);
+
+	// * Maps all further blocks from scratch files in the given directory, so that data larger than RAM gets paged out to disk.
+	// * workingSetLimit is the max nr of bytes that algorithms should keep in randomly accessed tables. Once the blocks exceed it,
+	// * filled blocks are evicted from the working set whenever a new one is started.
+	// * All blocks stay mapped at once, so data beyond ~1 GB needs a 64-bit build.
+	void EnableOutOfCore(const std::string& scratchDirectory, size_t workingSetLimit);
+
+	//Max nr of bytes for randomly accessed tables (0 => unlimited)
+	size_t GetWorkingSetLimit(void) const { return m_WorkingSetLimit; }
+
+	// * Returns memory for size bytes with the given alignment. Thread-safe.
+	void* Allocate(size_t size, size_t alignment);
+
+	// * Releases all allocations at once, keeping a single block of the default size around for the next job.
+	// * Nothing allocated from the arena may be used after this.
+	void Reset(void);
+
+	//Nr of bytes currently reserved from the system
+	size_t GetBytesReserved(void) const;
+
+	//Nr of bytes handed out since the last reset, which is also the peak of the current job
+	size_t GetBytesAllocated(void) const;
+
+	//Arena used by ArenaAllocators created on the calling thread (nullptr => global heap)
+	static ConversionArena* GetCurrent(void);
+
+private:
+	friend class ArenaScope;
+
+	struct Block{
+		char* pData;
+		size_t Size;
+		size_t Used;
+		ScratchFile* pFile; //nullptr for heap blocks
+	};
+
+	std::vector<Block> m_Blocks;
+	size_t m_BlockSize;
+	size_t m_BytesReserved;
+	size_t m_BytesAllocated;
+	std::string m_ScratchDirectory;
+	size_t m_WorkingSetLimit;
+	bool m_IsOutOfCore;
+	mutable std::mutex m_Mutex;
+
+	static thread_local ConversionArena* s_pCurrent;
+
+	Block CreateBlock(size_t size);
+	static void DestroyBlock(Block& block);
+
+	//Disabling copy constructor & assignment operator
+	ConversionArena(const ConversionArena& src);
+	ConversionArena& operator=(const ConversionArena& src);
+};
+
+// Makes an arena the current one of the calling thread for the lifetime of the scope
+class ArenaScope final
+{
+public:
+	ArenaScope(ConversionArena* pArena);
+	~ArenaScope(void);
+
+private:
+	ConversionArena* m_pPrevious;
+
+	//Disabling copy constructor & assignment operator
+	ArenaScope(const ArenaScope& src);
+	ArenaScope& operator=(const ArenaScope& src);
+};
+
+template<typename T>
+// STL allocator drawing from the arena that was current when the container was created.
+// Containers created outside of an ArenaScope use the global heap.
+struct ArenaAllocator
+{
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	ArenaAllocator(void) : pArena(ConversionArena::GetCurrent()) {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& src) : pArena(src.pArena) {}
+
+	T* allocate(size_t n)
+	{
+		if(pArena)
+			return static_cast<T*>(pArena->Allocate(n * sizeof(T), alignof(T)));
+		
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	//Arena memory is only released by ConversionArena::Reset
+	void deallocate(T* p, size_t)
+	{
+		if(!pArena)
+			::operator delete(p);
+	}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return pArena == other.pArena; }
+	
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return pArena != other.pArena; }
+
+	ConversionArena* pArena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
@@ -0,0 +1,188 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ConversionCache.h"
+#include "ContentHash.h"
+#include "StringUtils.h"
+#include "pugiXML/pugixml.hpp"
+
+#include <iostream>
+#include <chrono>
+
+using namespace std;
+using namespace pugi;
+
+//Increase whenever a change to the converter alters its output, so that cached conversions are redone
+static const unsigned int s_ConverterVersion = 1;
+
+//Constructor & Destructor
+//************************
+
+ConversionCache::ConversionCache(const string& manifestFilename):m_ManifestFilename(manifestFilename),
+																m_IsModified(false),
+																m_StopAutoSave(false)
+{
+	xml_document doc;
+	if(doc.load_file(m_ManifestFilename.c_str()).status != status_ok)
+		return;
+
+	for(auto& jobNode : doc.first_child().children(PUGIXML_TEXT("Job"))){
+		Entry& entry = m_Entries[FromXml(jobNode.attribute(PUGIXML_TEXT("Output")).value())];
+		entry.JobHash = ContentHash::FromString(FromXml(jobNode.attribute(PUGIXML_TEXT("Hash")).value()));
+
+		for(auto& outputNode : jobNode.children(PUGIXML_TEXT("File")))
+			entry.Outputs.push_back(make_pair(FromXml(outputNode.attribute(PUGIXML_TEXT("Name")).value()), 
+											  ContentHash::FromString(FromXml(outputNode.attribute(PUGIXML_TEXT("Hash")).value()))));
+	}
+}
+
+ConversionCache::~ConversionCache(void)
+{
+	if(!m_AutoSaveThread.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(m_Mutex);
+		m_StopAutoSave = true;
+	}
+	m_AutoSaveStopped.notify_one();
+	m_AutoSaveThread.join();
+
+	Save();
+}
+
+//Methods
+//*******
+
+unsigned long long ConversionCache::ComputeInputHash(const string& inFilename)
+{
+	ContentHash hash;
+	return hash.UpdateWithFile(inFilename) ? hash.Get() : 0;
+}
+
+unsigned long long ConversionCache::ComputeJobHash(const ConversionJob& job)
+{
+	if(job.InputHash == 0)
+		return 0;
+
+	ContentHash hash;
+	hash.Update(s_ConverterVersion);
+	hash.Update(job.InputHash);
+
+	hash.Update(static_cast<int>(job.GenerateCollision));
+	hash.Update(job.MergeStaticMeshes);
+	hash.Update(job.BonePaletteSize);
+
+	hash.Update(static_cast<unsigned int>(job.AnimClips.size()));
+	for(auto& animClip : job.AnimClips){
+		hash.Update(animClip.Name);
+		hash.Update(animClip.FramesPerSecond);
+		hash.Update(static_cast<unsigned int>(animClip.TransformsAtTimeStamps.size()));
+		for(auto& transformAtTime : animClip.TransformsAtTimeStamps)
+			hash.Update(transformAtTime.first);
+	}
+
+	return hash.Get();
+}
+
+bool ConversionCache::IsUpToDate(const ConversionJob& job, unsigned long long jobHash) const
+{
+	Entry entry;
+	{
+		lock_guard<mutex> lock(m_Mutex);
+	
+		auto it = m_Entries.find(job.OutputFilename);
+		if(jobHash == 0 || it == m_Entries.end() || it->second.JobHash != jobHash)
+			return false;
+
+		entry = it->second;
+	}
+
+	//Outputs that were removed or modified since are regenerated
+	for(auto& output : entry.Outputs){
+		ContentHash hash;
+		if(!hash.UpdateWithFile(output.first) || hash.Get() != output.second)
+			return false;
+	}
+
+	return true;
+}
+
+void ConversionCache::Update(const ConversionJob& job, unsigned long long jobHash, const vector<string>& outputFiles)
+{
+	Entry entry;
+	entry.JobHash = jobHash;
+
+	for(auto& filename : outputFiles){
+		ContentHash hash;
+		hash.UpdateWithFile(filename);
+		entry.Outputs.push_back(make_pair(filename, hash.Get()));
+	}
+
+	lock_guard<mutex> lock(m_Mutex);
+	m_Entries[job.OutputFilename] = entry;
+	m_IsModified = true;
+}
+
+void ConversionCache::Save(void)
+{
+	lock_guard<mutex> saveLock(m_SaveMutex);
+
+	//Write a copy, so that requests aren't held up by the disk
+	map<string, Entry> entries;
+	{
+		lock_guard<mutex> lock(m_Mutex);
+		if(!m_IsModified)
+			return;
+
+		entries = m_Entries;
+		m_IsModified = false;
+	}
+
+	xml_document doc;
+	auto root = doc.append_child(PUGIXML_TEXT("ConversionCache"));
+
+	for(auto& entry : entries){
+		auto jobNode = root.append_child(PUGIXML_TEXT("Job"));
+		jobNode.append_attribute(PUGIXML_TEXT("Output")).set_value(ToXml(entry.first).c_str());
+		jobNode.append_attribute(PUGIXML_TEXT("Hash")).set_value(ToXml(ContentHash::ToString(entry.second.JobHash)).c_str());
+
+		for(auto& output : entry.second.Outputs){
+			auto outputNode = jobNode.append_child(PUGIXML_TEXT("File"));
+			outputNode.append_attribute(PUGIXML_TEXT("Name")).set_value(ToXml(output.first).c_str());
+			outputNode.append_attribute(PUGIXML_TEXT("Hash")).set_value(ToXml(ContentHash::ToString(output.second)).c_str());
+		}
+	}
+
+	if(!doc.save_file(m_ManifestFilename.c_str()))
+		cout << "Unable to write " << m_ManifestFilename << ".\n";
+}
+
+void ConversionCache::EnableAutoSave(unsigned int intervalSeconds)
+{
+	if(m_AutoSaveThread.joinable())
+		return;
+
+	m_AutoSaveThread = thread([this, intervalSeconds]{
+		unique_lock<mutex> lock(m_Mutex);
+		while(!m_AutoSaveStopped.wait_for(lock, chrono::seconds(intervalSeconds), [this]{ return m_StopAutoSave; })){
+			lock.unlock();
+			Save();
+			lock.lock();
+		}
+	});
+}
@@ -0,0 +1,75 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "ConversionJob.h"
+
+// Persistent manifest of earlier conversions, used to skip jobs of which neither input nor settings changed.
+// Every job is recorded with a hash of its input bytes & settings and a hash per output file.
+class ConversionCache final
+{
+public:
+	ConversionCache(const std::string& manifestFilename);
+	~ConversionCache(void);
+
+	// * Hash of the contents of an input file (0 => unreadable).
+	static unsigned long long ComputeInputHash(const std::string& inFilename);
+
+	// * Hash of the job's InputHash, every setting that affects the output and the converter version (0 => no input hash).
+	static unsigned long long ComputeJobHash(const ConversionJob& job);
+
+	// * Checks if the job was converted before with the same job hash, and all of its outputs are still unchanged.
+	// * The outputs are hashed without holding the lock, so that concurrent requests don't wait for each other's reads.
+	bool IsUpToDate(const ConversionJob& job, unsigned long long jobHash) const;
+
+	// * Records the outputs of a successful conversion. Thread-safe.
+	void Update(const ConversionJob& job, unsigned long long jobHash, const std::vector<std::string>& outputFiles);
+
+	// * Writes the manifest if it changed since the last save. Thread-safe.
+	void Save(void);
+
+	// * Saves every intervalSeconds on a thread of its own, and once more on destruction. Meant for servers, which would
+	// * otherwise rewrite the whole manifest after every request.
+	void EnableAutoSave(unsigned int intervalSeconds);
+
+private:
+	struct Entry{
+		unsigned long long JobHash;
+		std::vector<std::pair<std::string, unsigned long long> > Outputs;
+	};
+
+	std::map<std::string, Entry> m_Entries; //Per output filename
+	std::string m_ManifestFilename;
+	bool m_IsModified;
+	mutable std::mutex m_Mutex;
+	std::mutex m_SaveMutex; //Serializes writes of the manifest, taken before m_Mutex
+
+	std::thread m_AutoSaveThread;
+	bool m_StopAutoSave;
+	std::condition_variable m_AutoSaveStopped;
+
+	//Disabling copy constructor & assignment operator
+	ConversionCache(const ConversionCache& src);
+	ConversionCache& operator=(const ConversionCache& src);
+};
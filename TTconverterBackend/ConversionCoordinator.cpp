@@ -0,0 +1,233 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ConversionCoordinator.h"
+#include "TcpConnection.h"
+#include "ContentHash.h"
+#include "StringUtils.h"
+
+#include <iostream>
+#include <fstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+//Nr of times a job is handed out before it counts as failed, a job that keeps taking down its worker shouldn't take down the farm
+static const unsigned int s_MaxAttempts = 3;
+
+//Interval at which the coordinator checks if the batch is done while waiting for workers
+static const unsigned int s_AcceptTimeoutMilliseconds = 100;
+
+//Milliseconds a worker may take to answer anything but a job, a worker that stays silent longer counts as lost
+static const unsigned int s_ReplyTimeoutMilliseconds = 60 * 1000;
+
+//Nr of seconds a worker gets past the time limit of its job to report it cancelled, before it counts as lost
+static const unsigned int s_CancelGracePeriod = 10;
+
+//Largest output a worker may send, and the size of the chunks it is written to disk in
+static const unsigned long long s_MaxOutputSize = 4ull * 1024 * 1024 * 1024;
+static const size_t s_TransferChunkSize = 1024 * 1024;
+
+//Fetches an output that the coordinator doesn't have yet, returns false if the connection is lost
+static bool FetchOutput(TcpConnection& connection, const string& name, const string& filename)
+{
+	string line;
+	if(!connection.Write("SEND\t" + name + "\n") || !connection.ReadLine(line) || line.compare(0, 5, "DATA\t") != 0)
+		return false;
+
+	char* pSizeEnd = nullptr;
+	unsigned long long size = strtoull(line.c_str() + 5, &pSizeEnd, 10);
+	if(pSizeEnd == line.c_str() + 5 || *pSizeEnd != '\0' || size > s_MaxOutputSize)
+		return false;
+
+	//Replace rather than overwrite, an existing file may be a hard link into a content store
+	remove(filename.c_str());
+	ofstream file(filename, ios::binary);
+
+	vector<char> chunk(s_TransferChunkSize);
+	for(unsigned long long remaining = size; remaining > 0; ){
+		size_t chunkSize = static_cast<size_t>(min<unsigned long long>(remaining, chunk.size()));
+		if(!connection.ReadBytes(chunk.data(), chunkSize)){
+			file.close();
+			remove(filename.c_str());
+			return false;
+		}
+		file.write(chunk.data(), chunkSize);
+		remaining -= chunkSize;
+	}
+	return true;
+}
+
+//Constructor & Destructor
+//************************
+
+ConversionCoordinator::ConversionCoordinator(const string& address, unsigned short port, const string& outputDirectory, const string& token):
+	m_Address(address),
+	m_Port(port),
+	m_OutputDirectory(outputDirectory),
+	m_Token(token)
+{}
+
+ConversionCoordinator::~ConversionCoordinator(void)
+{}
+
+//Methods
+//*******
+
+bool ConversionCoordinator::IsValidOutputName(const string& name)
+{
+	return !name.empty() && name.find_first_of("/\\:") == string::npos && name.find("..") == string::npos;
+}
+
+void ConversionCoordinator::Run(const vector<ConversionJob>& jobs, const vector<string>& requests, const JobFinishedCallback& onFinished)
+{
+	mutex queueMutex;
+	condition_variable queueChanged;
+	deque<unsigned int> queue;
+	vector<unsigned int> attempts(jobs.size(), 0);
+	unsigned int nrOfUnfinishedJobs = jobs.size();
+
+	for(unsigned int iJob=0; iJob < jobs.size(); ++iJob)
+		queue.push_back(iJob);
+
+	//Ends a job, or puts it back in the queue when its worker was lost
+	auto finishJob = [&](unsigned int iJob, JobStatus status, const vector<string>& outputFiles, double seconds, bool isWorkerLost){
+		{
+			unique_lock<mutex> lock(queueMutex);
+			if(isWorkerLost && attempts[iJob] < s_MaxAttempts){
+				cout << "Lost the worker of " << jobs[iJob].InputFilename << ", requeueing it.\n";
+				queue.push_front(iJob);
+				queueChanged.notify_all();
+				return;
+			}
+			--nrOfUnfinishedJobs;
+		}
+
+		if(isWorkerLost)
+			cout << "\nConversion of " << jobs[iJob].InputFilename << " failed: lost the worker " << s_MaxAttempts << " times.\n\n";
+		onFinished(jobs[iJob], status, outputFiles, seconds);
+		queueChanged.notify_all();
+	};
+
+	auto serveWorker = [&](TcpConnection* pConnection){
+		unique_ptr<TcpConnection> connection(pConnection);
+		string line;
+
+		//Reads time out, so that a worker that vanished without closing its connection doesn't hold up the batch
+		connection->EnableKeepAlive();
+		connection->SetReadTimeout(s_ReplyTimeoutMilliseconds);
+
+		if(!connection->ReadLine(line) || line != "HELLO\t" + m_Token){
+			cout << "Refused a worker with a wrong token.\n";
+			return;
+		}
+
+		while(connection->ReadLine(line) && line == "READY"){
+			//Wait for a job, jobs of lost workers may be requeued as long as jobs are running
+			unsigned int iJob;
+			{
+				unique_lock<mutex> lock(queueMutex);
+				queueChanged.wait(lock, [&]{ return !queue.empty() || nrOfUnfinishedJobs == 0; });
+				if(queue.empty()){
+					connection->Write("QUIT\n");
+					return;
+				}
+				iJob = queue.front();
+				queue.pop_front();
+				++attempts[iJob];
+			}
+
+			//Jobs without a time limit rely on keepalive to notice a lost worker
+			auto& job = jobs[iJob];
+			auto startTime = chrono::steady_clock::now();
+			connection->SetReadTimeout(job.TimeLimit > 0 ? static_cast<unsigned int>((job.TimeLimit + s_CancelGracePeriod) * 1000) : 0);
+			if(!connection->Write("JOB\t" + to_string(iJob) + "\t" + requests[iJob] + "\n") || !connection->ReadLine(line)){
+				finishJob(iJob, JobStatus::Failed, vector<string>(), 0, true);
+				return;
+			}
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+			connection->SetReadTimeout(s_ReplyTimeoutMilliseconds);
+
+			auto fields = SplitFields(line);
+			if(fields.size() < 2 || fields[1] != to_string(iJob) || (fields[0] != "DONE" && fields[0] != "FAILED" && fields[0] != "CANCELLED")){
+				finishJob(iJob, JobStatus::Failed, vector<string>(), 0, true);
+				return;
+			}
+
+			if(fields[0] != "DONE"){
+				cout << "\nConversion of " << job.InputFilename << " failed: " << (fields.size() > 2 ? fields[2] : "") << "\n\n";
+				finishJob(iJob, fields[0] == "CANCELLED" ? JobStatus::Cancelled : JobStatus::Failed, vector<string>(), 0, false);
+				continue;
+			}
+
+			//Outputs are named after the job, anything else would let a worker overwrite arbitrary files
+			const string outputPrefix = job.OutputFilename.substr(min(m_OutputDirectory.size(), job.OutputFilename.size()));
+			bool hasValidOutputs = true;
+			for(unsigned int iField = 2; iField + 1 < fields.size(); iField += 2)
+				hasValidOutputs = hasValidOutputs && IsValidOutputName(fields[iField]) && fields[iField].compare(0, outputPrefix.size(), outputPrefix) == 0;
+
+			if(!hasValidOutputs){
+				connection->Write("OK\n");
+				cout << "\nConversion of " << job.InputFilename << " failed: the worker reported outputs the job doesn't write.\n\n";
+				finishJob(iJob, JobStatus::Failed, vector<string>(), 0, false);
+				continue;
+			}
+
+			//Only outputs that differ from the files the coordinator sees are transferred
+			vector<string> outputFiles;
+			for(unsigned int iField = 2; iField + 1 < fields.size(); iField += 2){
+				string filename = m_OutputDirectory + fields[iField];
+				ContentHash hash;
+				if((!hash.UpdateWithFile(filename) || ContentHash::ToString(hash.Get()) != fields[iField + 1]) && !FetchOutput(*connection, fields[iField], filename)){
+					finishJob(iJob, JobStatus::Failed, vector<string>(), 0, true);
+					return;
+				}
+				outputFiles.push_back(filename);
+			}
+			connection->Write("OK\n");
+
+			cout << job.InputFilename << " converted.\n";
+			finishJob(iJob, JobStatus::Converted, outputFiles, seconds, false);
+		}
+	};
+
+	TcpListener listener(m_Address, m_Port);
+	cout << "Waiting for workers on " << m_Address << ":" << m_Port << "...\n";
+
+	vector<thread> workerThreads;
+	for(;;){
+		{
+			lock_guard<mutex> lock(queueMutex);
+			if(nrOfUnfinishedJobs == 0)
+				break;
+		}
+
+		auto pConnection = listener.Accept(s_AcceptTimeoutMilliseconds);
+		if(pConnection)
+			workerThreads.push_back(thread(serveWorker, pConnection.release()));
+	}
+
+	for(auto& workerThread : workerThreads)
+		workerThread.join();
+}
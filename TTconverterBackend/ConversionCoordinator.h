@@ -0,0 +1,67 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "ConversionJob.h"
+#include "ShardReport.h"
+
+class TcpConnection;
+
+// Hands out the jobs of a batch to workers connecting over TCP, as soon as a worker asks for one.
+// Workers report a hash per output file, outputs that don't match the coordinator's files are transferred.
+// Jobs of workers that disconnect, or don't answer within the job's time limit plus a grace period, are given to another worker.
+//
+// Protocol, one tab-separated line per message:
+//   worker:      HELLO <token>, once per connection, connections with another token are closed
+//   worker:      READY
+//   coordinator: JOB <id> <FbxFile element>, or QUIT when the batch is done
+//   worker:      DONE <id> [<output> <hash>]..., FAILED <id> <message>, or CANCELLED <id> <message> when the job ran out of time
+//   coordinator: after DONE, SEND <output> for every output it needs, each answered by DATA <size> followed by the bytes, then OK
+// Outputs are files directly in the output directory, named after the job's output. Other names are refused by both sides.
+class ConversionCoordinator final
+{
+public:
+	// * seconds: time the conversion took as seen from the coordinator or supervisor (0 if it didn't finish)
+	typedef std::function<void(const ConversionJob& job, JobStatus status, const std::vector<std::string>& outputFiles, double seconds)> JobFinishedCallback;
+
+	// * address: interface to listen on
+	// * outputDirectory: output path of batch.xml, the names of outputs are sent relative to it
+	// * token: secret shared with the workers
+	ConversionCoordinator(const std::string& address, unsigned short port, const std::string& outputDirectory, const std::string& token);
+	~ConversionCoordinator(void);
+
+	// * Converts the jobs on workers, requests[i] is the FbxFile element of jobs[i]. Returns when every job finished or failed.
+	// * onFinished is called on the thread of the worker's connection.
+	void Run(const std::vector<ConversionJob>& jobs, const std::vector<std::string>& requests, const JobFinishedCallback& onFinished);
+
+	// * Checks that an output name stays inside the output directory: not empty, no directories, no drive & no "..".
+	static bool IsValidOutputName(const std::string& name);
+
+private:
+	std::string m_Address;
+	unsigned short m_Port;
+	std::string m_OutputDirectory;
+	std::string m_Token;
+
+	//Disabling copy constructor & assignment operator
+	ConversionCoordinator(const ConversionCoordinator& src);
+	ConversionCoordinator& operator=(const ConversionCoordinator& src);
+};
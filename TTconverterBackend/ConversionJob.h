@@ -0,0 +1,62 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <fbxsdk.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "ConversionArena.h"
+
+namespace physx{ class PxCooking; }
+
+struct AnimClip{
+	std::string Name;
+	float FramesPerSecond;
+	std::map<double, ArenaVector<fbxsdk::FbxAMatrix> > TransformsAtTimeStamps;
+};
+
+enum class CollisionGeneration{
+	Convex,
+	Concave,
+	None
+};
+
+//Settings of a single fbx file in batch.xml
+struct ConversionJob{
+	std::string InputFilename;
+	std::string OutputFilename; //Without extension
+	CollisionGeneration GenerateCollision;
+	bool MergeStaticMeshes;
+	unsigned int BonePaletteSize;
+	std::vector<AnimClip> AnimClips; //Only the time stamps, transforms are sampled during conversion
+	size_t OutOfCoreLimit; //Max nr of bytes for in-memory tables, intermediate data goes to scratch files (0 => in-core)
+	std::string ScratchDirectory;
+	std::string IntermediateCacheDirectory; //Empty => extracted data isn't cached
+	std::string ContentStoreDirectory; //Empty => outputs aren't deduplicated
+	unsigned long long InputHash; //Hash of the input file's contents, computed along with JobHash (0 => not computed)
+	unsigned long long JobHash; //Hash of input & settings, only computed for incremental conversion
+	double TimeLimit; //Max nr of seconds the conversion may take before it is cancelled (0 => no limit)
+	bool WriteReport; //Write a timing & statistics report next to the outputs
+};
+
+//Sdk objects shared by successive conversions, null members are created & released by every conversion
+struct ConversionContext{
+	fbxsdk::FbxManager* pFbxManager;
+	physx::PxCooking* pCooker;
+};
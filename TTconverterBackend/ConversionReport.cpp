@@ -0,0 +1,433 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ConversionReport.h"
+#include "ConversionJob.h"
+#include "ConversionArena.h"
+#include "StringUtils.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <time.h>
+#endif
+
+using namespace std;
+
+thread_local ConversionReport* ConversionReport::s_pCurrent = nullptr;
+thread_local const char* StageScope::s_pCurrent = nullptr;
+
+//Values of a report that can't be added up when merging reports
+static const string s_TrianglesPerSecond = "TrianglesPerSecond";
+
+//Cpu time used by the calling thread
+static double GetThreadCpuSeconds(void)
+{
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime);
+
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+	return (kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+	timespec time;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
+
+static void SkipWhitespace(const string& text, size_t& pos)
+{
+	while(pos < text.size() && isspace(static_cast<unsigned char>(text[pos])))
+		++pos;
+}
+
+static bool ParseString(const string& text, size_t& pos, string& str)
+{
+	if(pos >= text.size() || text[pos] != '"')
+		return false;
+
+	for(++pos; pos < text.size() && text[pos] != '"'; ++pos){
+		if(text[pos] != '\\'){
+			str += text[pos];
+			continue;
+		}
+
+		if(++pos >= text.size())
+			return false;
+
+		switch(text[pos]){
+		case 'n': str += '\n'; break;
+		case 'r': str += '\r'; break;
+		case 't': str += '\t'; break;
+		case 'u':
+			if(pos + 4 >= text.size())
+				return false;
+			str += static_cast<char>(strtol(text.substr(pos + 1, 4).c_str(), nullptr, 16));
+			pos += 4;
+			break;
+		default: str += text[pos];
+		}
+	}
+
+	return pos++ < text.size();
+}
+
+//Reads the objects, numbers & strings of a report into values by their path, arrays aren't part of a job report
+static bool ParseValue(const string& text, size_t& pos, const string& path, map<string, double>& values, map<string, string>& strings)
+{
+	SkipWhitespace(text, pos);
+	if(pos >= text.size())
+		return false;
+
+	if(text[pos] == '"')
+		return ParseString(text, pos, strings[path]);
+
+	if(text[pos] != '{'){
+		const char* pBegin = text.c_str() + pos;
+		char* pEnd = nullptr;
+		values[path] = strtod(pBegin, &pEnd);
+		pos += pEnd - pBegin;
+		return pEnd != pBegin;
+	}
+
+	for(++pos;;){
+		SkipWhitespace(text, pos);
+		if(pos < text.size() && text[pos] == '}'){
+			++pos;
+			return true;
+		}
+
+		string name;
+		if(!ParseString(text, pos, name))
+			return false;
+
+		SkipWhitespace(text, pos);
+		if(pos >= text.size() || text[pos++] != ':')
+			return false;
+
+		if(!ParseValue(text, pos, path.empty() ? name : path + "." + name, values, strings))
+			return false;
+
+		SkipWhitespace(text, pos);
+		if(pos < text.size() && text[pos] == ',')
+			++pos;
+	}
+}
+
+//Writes the values of which the path continues after prefixLength characters as members of an object
+static void WriteMembers(ostream& stream, map<string, double>::const_iterator begin, map<string, double>::const_iterator end, size_t prefixLength, const string& indent, bool isFirst)
+{
+	for(auto it = begin; it != end; isFirst = false){
+		stream << (isFirst ? "\n" : ",\n") << indent;
+
+		string name = it->first.substr(prefixLength);
+		auto iDot = name.find('.');
+		if(iDot == string::npos){
+			stream << ToJson(name) << ": " << it->second;
+			++it;
+			continue;
+		}
+
+		//Values below the same member are adjacent in the sorted map
+		name = name.substr(0, iDot + 1);
+		auto memberEnd = it;
+		while(memberEnd != end && memberEnd->first.compare(prefixLength, name.size(), name) == 0)
+			++memberEnd;
+
+		stream << ToJson(name.substr(0, iDot)) << ": {";
+		WriteMembers(stream, it, memberEnd, prefixLength + name.size(), indent + "\t", true);
+		stream << "\n" << indent << "}";
+		it = memberEnd;
+	}
+}
+
+//Constructor & Destructor
+//************************
+
+ConversionReport::ConversionReport(void):m_Begin(chrono::steady_clock::now())
+{}
+
+ConversionReport::~ConversionReport(void)
+{}
+
+ReportScope::ReportScope(ConversionReport* pReport):m_pPrevious(ConversionReport::s_pCurrent)
+{
+	ConversionReport::s_pCurrent = pReport;
+}
+
+ReportScope::~ReportScope(void)
+{
+	ConversionReport::s_pCurrent = m_pPrevious;
+}
+
+StageScope::StageScope(const char* name):m_pReport(name ? ConversionReport::s_pCurrent : nullptr), m_Name(name), m_PreviousName(s_pCurrent), m_CpuBegin(0), m_AllocationsBegin(), m_HasCounts(false), m_HasPeakReset(false), m_Zone(name)
+{
+	//Scopes without a name don't change the stage
+	if(!m_Name)
+		return;
+
+	s_pCurrent = m_Name;
+	if(!m_pReport)
+		return;
+
+	m_CpuBegin = GetThreadCpuSeconds();
+	if(AllocationTracker::IsEnabled()){
+		m_AllocationsBegin = AllocationTracker::GetThreadCounters();
+		m_HasPeakReset = AllocationTracker::ResetRecentPeakResidentSetSize();
+	}
+	if(PerfCounters::IsEnabled())
+		m_HasCounts = PerfCounters::Read(m_CountsBegin);
+
+	lock_guard<mutex> lock(m_pReport->m_Mutex);
+	auto& stage = m_pReport->m_ActiveStages[m_Name];
+	if(stage.NrOfScopes++ == 0)
+		stage.Begin = chrono::steady_clock::now();
+}
+
+StageScope::~StageScope(void)
+{
+	Stop();
+}
+
+BatchReport::BatchReport(void):m_Begin(chrono::steady_clock::now())
+{}
+
+BatchReport::~BatchReport(void)
+{}
+
+//Methods
+//*******
+
+void StageScope::Stop(void)
+{
+	if(!m_Name)
+		return;
+
+	const char* name = m_Name;
+	m_Name = nullptr;
+	s_pCurrent = m_PreviousName;
+	m_Zone.Stop();
+	if(!m_pReport)
+		return;
+
+	PerfCounters::Sample countsEnd;
+	bool hasCounts = m_HasCounts && PerfCounters::Read(countsEnd);
+	double cpuSeconds = GetThreadCpuSeconds() - m_CpuBegin;
+	string path = string("Stages.") + name;
+
+	//Net heap bytes are those allocated by the stage that it didn't free itself
+	bool isTracking = AllocationTracker::IsEnabled();
+	auto allocations = AllocationTracker::GetThreadCounters();
+	unsigned long long peakRss = m_HasPeakReset ? AllocationTracker::GetRecentPeakResidentSetSize() : 0;
+
+	lock_guard<mutex> lock(m_pReport->m_Mutex);
+	m_pReport->m_Values[path + ".CpuSeconds"] += cpuSeconds;
+
+	if(isTracking){
+		auto& values = m_pReport->m_Values;
+		if(AllocationTracker::TracksHeapAllocations()){
+			values[path + ".HeapBytes"] += static_cast<double>(allocations.HeapAllocated - m_AllocationsBegin.HeapAllocated);
+			values[path + ".NetHeapBytes"] += static_cast<double>(allocations.HeapAllocated - m_AllocationsBegin.HeapAllocated) - static_cast<double>(allocations.HeapFreed - m_AllocationsBegin.HeapFreed);
+		}
+		values[path + ".ArenaBytes"] += static_cast<double>(allocations.ArenaAllocated - m_AllocationsBegin.ArenaAllocated);
+		if(m_HasPeakReset)
+			values[path + ".PeakRssBytes"] = max(values[path + ".PeakRssBytes"], static_cast<double>(peakRss));
+	}
+
+	if(hasCounts){
+		double counts[PerfCounters::NrOfCounters];
+		PerfCounters::GetCounts(m_CountsBegin, countsEnd, counts);
+		for(unsigned int i=0; i < PerfCounters::NrOfCounters; ++i)
+			m_pReport->m_Values[path + "." + PerfCounters::GetName(static_cast<PerfCounters::Counter>(i))] += counts[i];
+	}
+
+	auto& stage = m_pReport->m_ActiveStages[name];
+	if(--stage.NrOfScopes == 0)
+		m_pReport->m_Values[path + ".WallSeconds"] += chrono::duration<double>(chrono::steady_clock::now() - stage.Begin).count();
+}
+
+string ConversionReport::GetFilename(const ConversionJob& job)
+{
+	return job.OutputFilename + ".report.json";
+}
+
+void ConversionReport::Count(const string& name, double value)
+{
+	auto pReport = s_pCurrent;
+	if(!pReport)
+		return;
+
+	lock_guard<mutex> lock(pReport->m_Mutex);
+	pReport->m_Values[name] += value;
+}
+
+ConversionReport* ConversionReport::GetCurrent(void)
+{
+	return s_pCurrent;
+}
+
+const char* StageScope::GetCurrent(void)
+{
+	return s_pCurrent;
+}
+
+void ConversionReport::Merge(const ConversionReport& other)
+{
+	lock_guard<mutex> lock(m_Mutex);
+	lock_guard<mutex> otherLock(other.m_Mutex);
+
+	for(auto& value : other.m_Values){
+		if(value.first == s_TrianglesPerSecond)
+			continue;
+
+		auto iName = value.first.find_last_of('.') + 1;
+		auto& merged = m_Values[value.first];
+		merged = value.first.compare(iName, 4, "Peak") == 0 ? max(merged, value.second) : merged + value.second;
+	}
+}
+
+bool ConversionReport::Load(const string& filename)
+{
+	ifstream file(filename, ios::binary);
+	if(!file)
+		return false;
+
+	ostringstream text;
+	text << file.rdbuf();
+
+	map<string, double> values;
+	map<string, string> strings;
+	size_t pos = 0;
+	if(!ParseValue(text.str(), pos, "", values, strings))
+		return false;
+
+	lock_guard<mutex> lock(m_Mutex);
+	m_Values.swap(values);
+	m_Strings.swap(strings);
+	return true;
+}
+
+void ConversionReport::Save(const string& filename, const ConversionJob& job)
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	m_Strings["Input"] = job.InputFilename;
+	m_Strings["Output"] = job.OutputFilename;
+
+	double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - m_Begin).count();
+	m_Values["WallSeconds"] = wallSeconds;
+	if(wallSeconds > 0 && m_Values.count("Triangles"))
+		m_Values[s_TrianglesPerSecond] = m_Values.at("Triangles") / wallSeconds;
+
+	//Peaks of the whole process, they include the jobs converted alongside this one
+	if(AllocationTracker::IsEnabled()){
+		unsigned long long rss, peakRss;
+		AllocationTracker::GetResidentSetSize(rss, peakRss);
+		m_Values["Memory.PeakRssBytes"] = static_cast<double>(peakRss);
+		if(AllocationTracker::TracksHeapAllocations())
+			m_Values["Memory.PeakLiveHeapBytes"] = static_cast<double>(AllocationTracker::GetPeakLiveHeapBytes());
+
+		auto pArena = ConversionArena::GetCurrent();
+		if(pArena)
+			m_Values["Memory.ArenaBytes"] = static_cast<double>(pArena->GetBytesAllocated());
+	}
+
+	ofstream file(filename);
+	Write(file, "");
+	file << "\n";
+
+	if(!file)
+		cout << "Unable to write " << filename << ".\n";
+}
+
+void ConversionReport::Write(ostream& stream, const string& indent) const
+{
+	stream.precision(15);
+	stream << "{";
+
+	bool isFirst = true;
+	for(auto& str : m_Strings){
+		stream << (isFirst ? "\n" : ",\n") << indent << "\t" << ToJson(str.first) << ": " << ToJson(str.second);
+		isFirst = false;
+	}
+
+	WriteMembers(stream, m_Values.begin(), m_Values.end(), 0, indent + "\t", isFirst);
+	stream << "\n" << indent << "}";
+}
+
+void BatchReport::Add(unique_ptr<ConversionReport> pReport)
+{
+	lock_guard<mutex> lock(m_Mutex);
+	m_JobReports.push_back(move(pReport));
+}
+
+void BatchReport::Add(const ConversionJob& job)
+{
+	unique_ptr<ConversionReport> pReport(new ConversionReport());
+	if(!pReport->Load(ConversionReport::GetFilename(job))){
+		cout << "Unable to read the report of " << job.InputFilename << ".\n";
+		return;
+	}
+
+	lock_guard<mutex> lock(m_Mutex);
+	m_JobReports.push_back(move(pReport));
+}
+
+void BatchReport::Save(const string& filename) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	//Totals of all jobs, the throughput of the batch is based on its own wall time
+	ConversionReport totals;
+	for(auto& pReport : m_JobReports)
+		totals.Merge(*pReport);
+
+	double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - m_Begin).count();
+	double triangles = totals.m_Values.count("Triangles") ? totals.m_Values.at("Triangles") : 0;
+
+	ofstream file(filename);
+	file.precision(15);
+	file << "{\n";
+	file << "\t\"Jobs\": " << m_JobReports.size() << ",\n";
+	file << "\t\"WallSeconds\": " << wallSeconds << ",\n";
+	file << "\t\"" << s_TrianglesPerSecond << "\": " << (wallSeconds > 0 ? triangles / wallSeconds : 0) << ",\n";
+	file << "\t\"Totals\": ";
+	totals.Write(file, "\t");
+	file << ",\n\t\"JobReports\": [";
+
+	for(unsigned int i=0; i < m_JobReports.size(); ++i){
+		file << (i == 0 ? "\n\t\t" : ",\n\t\t");
+		m_JobReports[i]->Write(file, "\t\t");
+	}
+	file << "\n\t]\n}\n";
+
+	if(!file)
+		cout << "Unable to write " << filename << ".\n";
+}
@@ -0,0 +1,156 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include "Trace.h"
+#include "AllocationTracker.h"
+#include "PerfCounters.h"
+
+struct ConversionJob;
+
+// Timing & statistics of a single conversion, written as a JSON report.
+// Values are kept by their path in the report ("Stages.Import.WallSeconds", "Elements.Normals.After", ...), reports of several jobs are merged by adding them up.
+// Peaks (values named Peak...) are merged by taking the largest one.
+class ConversionReport final
+{
+public:
+	ConversionReport(void);
+	~ConversionReport(void);
+
+	// * Report of a job, next to its outputs.
+	static std::string GetFilename(const ConversionJob& job);
+
+	// * Adds a value to the report of the calling thread, if there is one. Thread-safe.
+	static void Count(const std::string& name, double value);
+
+	//Report the calling thread adds to (nullptr => statistics aren't collected)
+	static ConversionReport* GetCurrent(void);
+
+	void Merge(const ConversionReport& other);
+
+	// * Reads a report written by Save, returns false if it can't be read.
+	bool Load(const std::string& filename);
+	// * Writes the report, with the time since construction as the job's wall time.
+	void Save(const std::string& filename, const ConversionJob& job);
+
+private:
+	friend class ReportScope;
+	friend class StageScope;
+	friend class BatchReport;
+
+	//Stages running on several threads at once are timed from the first scope entering to the last one leaving
+	struct ActiveStage{
+		unsigned int NrOfScopes;
+		std::chrono::steady_clock::time_point Begin;
+	};
+
+	std::map<std::string, double> m_Values;
+	std::map<std::string, std::string> m_Strings;
+	std::map<std::string, ActiveStage> m_ActiveStages;
+	std::chrono::steady_clock::time_point m_Begin;
+	mutable std::mutex m_Mutex;
+
+	static thread_local ConversionReport* s_pCurrent;
+
+	void Write(std::ostream& stream, const std::string& indent) const;
+
+	//Disabling copy constructor & assignment operator
+	ConversionReport(const ConversionReport& src);
+	ConversionReport& operator=(const ConversionReport& src);
+};
+
+// Makes a report the one the calling thread adds to for the lifetime of the scope
+class ReportScope final
+{
+public:
+	ReportScope(ConversionReport* pReport);
+	~ReportScope(void);
+
+private:
+	ConversionReport* m_pPrevious;
+
+	//Disabling copy constructor & assignment operator
+	ReportScope(const ReportScope& src);
+	ReportScope& operator=(const ReportScope& src);
+};
+
+// Adds the wall & cpu time of a block to a stage of the calling thread's report, and records it as a trace zone while tracing.
+// While allocations are tracked, the heap & arena bytes allocated by the block are added too, and on Linux the peak resident set size
+// since the block started; stages running at the same time restart each other's peak, so theirs only covers the time since the latest start.
+// While performance counters are enabled, the hardware counts of the block are added as well.
+// Does nothing without a report or trace, or for a null name.
+// Stage scopes of a thread don't nest, the threads of ParallelFor time their cpu usage in the stage of the calling thread.
+class StageScope final
+{
+public:
+	StageScope(const char* name);
+	~StageScope(void);
+
+	// * Ends the stage before the end of the scope.
+	void Stop(void);
+
+	//Stage of the calling thread (nullptr => none)
+	static const char* GetCurrent(void);
+
+private:
+	ConversionReport* m_pReport;
+	const char* m_Name;
+	const char* m_PreviousName;
+	double m_CpuBegin;
+	AllocationTracker::Counters m_AllocationsBegin;
+	PerfCounters::Sample m_CountsBegin;
+	bool m_HasCounts;
+	bool m_HasPeakReset;
+	TraceZone m_Zone;
+
+	static thread_local const char* s_pCurrent;
+
+	//Disabling copy constructor & assignment operator
+	StageScope(const StageScope& src);
+	StageScope& operator=(const StageScope& src);
+};
+
+// Collects the reports of the converted jobs of a batch, written as a single report with their totals
+class BatchReport final
+{
+public:
+	BatchReport(void);
+	~BatchReport(void);
+
+	// * Adds the report of a job converted in this process. Thread-safe.
+	void Add(std::unique_ptr<ConversionReport> pReport);
+	// * Reads the report of a job converted elsewhere (a worker process or a remote worker) from its file. Thread-safe.
+	void Add(const ConversionJob& job);
+
+	void Save(const std::string& filename) const;
+
+private:
+	std::vector<std::unique_ptr<ConversionReport> > m_JobReports;
+	std::chrono::steady_clock::time_point m_Begin;
+	mutable std::mutex m_Mutex;
+
+	//Disabling copy constructor & assignment operator
+	BatchReport(const BatchReport& src);
+	BatchReport& operator=(const BatchReport& src);
+};
@@ -0,0 +1,286 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ConversionServer.h"
+#include "CancellationToken.h"
+#include "FbxFileReader.h"
+
+#include <stdexcept>
+#include <thread>
+#include <iostream>
+
+#include <fbxsdk.h>
+#include <PxVersionNumber.h>
+#include <Px.h>
+#include <PxFoundation.h>
+#include <cooking/PxCooking.h>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <unistd.h>
+	#include <signal.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+#endif
+
+using namespace std;
+using namespace physx;
+
+//Block size of the arenas of out-of-core requests, blocks live in scratch files
+static const size_t s_ScratchBlockSize = 256 * 1024 * 1024;
+
+//Size of the buffers requests are received in
+static const size_t s_ReceiveBufferSize = 64 * 1024;
+
+//Max size of a single request line, clients that send more without a newline are disconnected
+static const size_t s_MaxRequestSize = 1024 * 1024;
+
+#ifdef _WIN32
+
+static bool Receive(void* connection, char* pBuffer, size_t size, size_t& received)
+{
+	DWORD nrOfBytes = 0;
+	if(!ReadFile(connection, pBuffer, static_cast<DWORD>(size), &nrOfBytes, nullptr) || nrOfBytes == 0)
+		return false;
+
+	received = nrOfBytes;
+	return true;
+}
+
+static bool Send(void* connection, const string& data)
+{
+	DWORD nrOfBytes = 0;
+	return WriteFile(connection, data.data(), static_cast<DWORD>(data.size()), &nrOfBytes, nullptr) && nrOfBytes == data.size();
+}
+
+static void Close(void* connection)
+{
+	FlushFileBuffers(connection);
+	DisconnectNamedPipe(connection);
+	CloseHandle(connection);
+}
+
+#else
+
+static bool Receive(int connection, char* pBuffer, size_t size, size_t& received)
+{
+	ssize_t nrOfBytes = recv(connection, pBuffer, size, 0);
+	if(nrOfBytes <= 0)
+		return false;
+
+	received = static_cast<size_t>(nrOfBytes);
+	return true;
+}
+
+static bool Send(int connection, const string& data)
+{
+	for(size_t sent = 0; sent < data.size(); ){
+		ssize_t nrOfBytes = send(connection, data.data() + sent, data.size() - sent, 0);
+		if(nrOfBytes <= 0)
+			return false;
+		sent += static_cast<size_t>(nrOfBytes);
+	}
+	return true;
+}
+
+static void Close(int connection)
+{
+	close(connection);
+}
+
+#endif
+
+//Constructor & Destructor
+//************************
+
+ConversionServer::ConversionServer(const string& address, unsigned int maxConcurrentJobs):m_Address(address)
+{
+	if(maxConcurrentJobs == 0)
+		maxConcurrentJobs = max(thread::hardware_concurrency(), 1u);
+
+	//Create the sdk objects of every request slot up front, so that no request pays for them
+	PxCookingParams params{ PxTolerancesScale() };
+	for(unsigned int i=0; i < maxConcurrentJobs; ++i){
+		unique_ptr<Slot> pSlot(new Slot());
+		pSlot->Context.pFbxManager = FbxFileReader::CreateSdkManager();
+		pSlot->Context.pCooker = PxCreateCooking(PX_PHYSICS_VERSION, PxGetFoundation(), params);
+		pSlot->pArena.reset(new ConversionArena());
+
+		m_IdleSlots.push_back(pSlot.get());
+		m_Slots.push_back(move(pSlot));
+	}
+
+#ifndef _WIN32
+	//Clients that disconnect early shouldn't take the server down
+	signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+ConversionServer::~ConversionServer(void)
+{
+	for(auto& pSlot : m_Slots){
+		pSlot->Context.pCooker->release();
+		FbxFileReader::DestroySdkManager(pSlot->Context.pFbxManager);
+	}
+}
+
+//Methods
+//*******
+
+void ConversionServer::EnableOutOfCore(const string& scratchDirectory, size_t workingSetLimit)
+{
+	lock_guard<mutex> lock(m_Mutex);
+	for(auto& pSlot : m_Slots){
+		pSlot->pArena.reset(new ConversionArena(s_ScratchBlockSize));
+		pSlot->pArena->EnableOutOfCore(scratchDirectory, workingSetLimit);
+	}
+}
+
+#ifdef _WIN32
+
+void ConversionServer::Run(const RequestHandler& handler)
+{
+	cout << "Listening on " << m_Address << "...\n";
+
+	//Every client is connected to a pipe instance of its own
+	for(;;){
+		HANDLE hPipe = CreateNamedPipeA(m_Address.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, 
+										PIPE_UNLIMITED_INSTANCES, s_ReceiveBufferSize, s_ReceiveBufferSize, 0, nullptr);
+		if(hPipe == INVALID_HANDLE_VALUE)
+			throw runtime_error("Failed to create pipe " + m_Address);
+
+		if(!ConnectNamedPipe(hPipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED){
+			CloseHandle(hPipe);
+			continue;
+		}
+
+		thread(&ConversionServer::ServeClient, this, hPipe, cref(handler)).detach();
+	}
+}
+
+#else
+
+void ConversionServer::Run(const RequestHandler& handler)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if(m_Address.size() >= sizeof(address.sun_path))
+		throw runtime_error("Socket filename is too long: " + m_Address);
+	m_Address.copy(address.sun_path, m_Address.size());
+
+	int listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenSocket < 0)
+		throw runtime_error("Failed to create socket");
+
+	//Remove the socket of an earlier server
+	unlink(m_Address.c_str());
+	if(::bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, SOMAXCONN) != 0){
+		close(listenSocket);
+		throw runtime_error("Failed to listen on " + m_Address);
+	}
+
+	cout << "Listening on " << m_Address << "...\n";
+
+	for(;;){
+		int connection = accept(listenSocket, nullptr, nullptr);
+		if(connection >= 0)
+			thread(&ConversionServer::ServeClient, this, connection, cref(handler)).detach();
+	}
+}
+
+#endif
+
+void ConversionServer::ServeClient(Connection connection, const RequestHandler& handler)
+{
+	vector<char> buffer(s_ReceiveBufferSize);
+	string pending;
+	size_t received;
+
+	while(Receive(connection, buffer.data(), buffer.size(), received)){
+		pending.append(buffer.data(), received);
+
+		//Handle every complete line
+		size_t iLineEnd;
+		while((iLineEnd = pending.find('\n')) != string::npos){
+			string request = pending.substr(0, iLineEnd);
+			pending.erase(0, iLineEnd + 1);
+
+			if(!request.empty() && request.back() == '\r')
+				request.pop_back();
+			if(request.empty())
+				continue;
+
+			if(!Send(connection, HandleRequest(request, handler))){
+				Close(connection);
+				return;
+			}
+		}
+
+		if(pending.size() > s_MaxRequestSize){
+			Send(connection, "ERROR\tRequest is too long\n");
+			break;
+		}
+	}
+
+	Close(connection);
+}
+
+string ConversionServer::HandleRequest(const string& request, const RequestHandler& handler)
+{
+	//Wait for an idle slot
+	Slot* pSlot;
+	{
+		unique_lock<mutex> lock(m_Mutex);
+		m_SlotReleased.wait(lock, [this]{ return !m_IdleSlots.empty(); });
+		pSlot = m_IdleSlots.back();
+		m_IdleSlots.pop_back();
+	}
+
+	string response;
+	try{
+		vector<string> outputFiles;
+		{
+			ArenaScope arenaScope(pSlot->pArena.get());
+			outputFiles = handler(request, pSlot->Context);
+		}
+
+		response = "OK";
+		for(auto& filename : outputFiles)
+			response += "\t" + filename;
+	}
+	catch(exception& e){
+		//Keep the response on a single line
+		string message = e.what();
+		for(auto& c : message)
+			if(c == '\n' || c == '\r' || c == '\t')
+				c = ' ';
+		response = (dynamic_cast<JobCancelled*>(&e) ? "CANCELLED\t" : "ERROR\t") + message;
+	}
+
+	//The arena keeps a single block of the default size for the next request
+	pSlot->pArena->Reset();
+
+	{
+		lock_guard<mutex> lock(m_Mutex);
+		m_IdleSlots.push_back(pSlot);
+	}
+	m_SlotReleased.notify_one();
+
+	return response + "\n";
+}
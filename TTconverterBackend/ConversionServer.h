@@ -0,0 +1,77 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "ConversionJob.h"
+#include "ConversionArena.h"
+
+// Long-running conversion service, accepting jobs over a local Unix socket (a named pipe on Windows).
+// Every request is a single line, answered by a single line: "OK" followed by the written files, 
+// "CANCELLED" followed by a message when the job ran out of time, or "ERROR" followed by a message.
+// Fields of a response are separated by tabs.
+class ConversionServer final
+{
+public:
+	// * Converts the job described by the request, using the sdk objects of the context. Throws to report failure.
+	typedef std::function<std::vector<std::string>(const std::string& request, const ConversionContext& context)> RequestHandler;
+
+	// * address: filename of the socket, or name of the pipe on Windows (\\.\pipe\...)
+	// * maxConcurrentJobs: max nr of requests handled at once (0 => nr of hardware threads)
+	ConversionServer(const std::string& address, unsigned int maxConcurrentJobs);
+	~ConversionServer(void);
+
+	// * Requests are handled with out-of-core arenas from now on.
+	void EnableOutOfCore(const std::string& scratchDirectory, size_t workingSetLimit);
+
+	// * Serves clients until the process ends. Every client gets a thread of its own, its requests are handled in order.
+	void Run(const RequestHandler& handler);
+
+	// * Handles a single request as soon as a slot is idle, returns the response line.
+	std::string HandleRequest(const std::string& request, const RequestHandler& handler);
+
+private:
+#ifdef _WIN32
+	typedef void* Connection;
+#else
+	typedef int Connection;
+#endif
+
+	//Fbx manager, cooker & arena, kept warm for the next request
+	struct Slot{
+		ConversionContext Context;
+		std::unique_ptr<ConversionArena> pArena;
+	};
+
+	std::string m_Address;
+	std::vector<std::unique_ptr<Slot> > m_Slots;
+	std::vector<Slot*> m_IdleSlots;
+	std::mutex m_Mutex;
+	std::condition_variable m_SlotReleased;
+
+	void ServeClient(Connection connection, const RequestHandler& handler);
+
+	//Disabling copy constructor & assignment operator
+	ConversionServer(const ConversionServer& src);
+	ConversionServer& operator=(const ConversionServer& src);
+};
@@ -0,0 +1,154 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ConversionWorker.h"
+#include "ConversionCoordinator.h"
+#include "TcpConnection.h"
+#include "ContentHash.h"
+#include "ConversionArena.h"
+#include "CancellationToken.h"
+#include "FbxFileReader.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+
+#include <fbxsdk.h>
+#include <PxVersionNumber.h>
+#include <Px.h>
+#include <PxFoundation.h>
+#include <cooking/PxCooking.h>
+
+using namespace std;
+using namespace physx;
+
+//Keep error messages on a single line
+static string ToField(string str)
+{
+	replace_if(str.begin(), str.end(), [](char c){ return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+	return str;
+}
+
+//Constructor & Destructor
+//************************
+
+ConversionWorker::ConversionWorker(const string& host, unsigned short port, unsigned int nrOfConnections, const string& outputDirectory, const string& token):
+	m_Host(host),
+	m_Port(port),
+	m_NrOfConnections(nrOfConnections > 0 ? nrOfConnections : max(thread::hardware_concurrency(), 1u)),
+	m_OutputDirectory(outputDirectory),
+	m_Token(token)
+{}
+
+ConversionWorker::~ConversionWorker(void)
+{}
+
+//Methods
+//*******
+
+void ConversionWorker::Run(const ConversionServer::RequestHandler& handler)
+{
+	mutex outputMutex;
+	vector<thread> threads;
+
+	for(unsigned int i=0; i < m_NrOfConnections; ++i)
+		threads.push_back(thread([&]{
+			try{
+				auto pConnection = TcpConnection::Connect(m_Host, m_Port);
+				ServeCoordinator(*pConnection, handler);
+			}
+			catch(exception& e){
+				lock_guard<mutex> lock(outputMutex);
+				cout << e.what() << "\n";
+			}
+		}));
+
+	for(auto& connectionThread : threads)
+		connectionThread.join();
+}
+
+void ConversionWorker::ServeCoordinator(TcpConnection& connection, const ConversionServer::RequestHandler& handler)
+{
+	PxCookingParams params{ PxTolerancesScale() };
+	ConversionContext context;
+	context.pFbxManager = FbxFileReader::CreateSdkManager();
+	context.pCooker = PxCreateCooking(PX_PHYSICS_VERSION, PxGetFoundation(), params);
+	ConversionArena arena;
+
+	string line;
+	bool isConnected = connection.Write("HELLO\t" + m_Token + "\n");
+	while(isConnected && connection.Write("READY\n") && connection.ReadLine(line) && line.compare(0, 4, "JOB\t") == 0){
+		auto iIdEnd = line.find('\t', 4);
+		string id = line.substr(4, iIdEnd - 4);
+		string response;
+		set<string> outputNames; //Only these may be sent to the coordinator
+		bool isDone = false;
+
+		try{
+			vector<string> outputFiles;
+			{
+				ArenaScope arenaScope(&arena);
+				outputFiles = handler(iIdEnd == string::npos ? string() : line.substr(iIdEnd + 1), context);
+			}
+
+			//Outputs are identified by their hash, and named relative to the output directory
+			response = "DONE\t" + id;
+			for(auto& filename : outputFiles){
+				ContentHash hash;
+				hash.UpdateWithFile(filename);
+				string name = filename.compare(0, m_OutputDirectory.size(), m_OutputDirectory) == 0 ? filename.substr(m_OutputDirectory.size()) : filename;
+				response += "\t" + name + "\t" + ContentHash::ToString(hash.Get());
+				outputNames.insert(name);
+			}
+			isDone = true;
+		}
+		catch(JobCancelled& e){
+			response = "CANCELLED\t" + id + "\t" + ToField(e.what());
+		}
+		catch(exception& e){
+			response = "FAILED\t" + id + "\t" + ToField(e.what());
+		}
+		arena.Reset();
+
+		if(!connection.Write(response + "\n"))
+			break;
+
+		//Send the outputs the coordinator asks for, a request for any other file ends the connection
+		while(isDone && connection.ReadLine(line) && line.compare(0, 5, "SEND\t") == 0){
+			string name = line.substr(5);
+			if(!outputNames.count(name) || !ConversionCoordinator::IsValidOutputName(name)){
+				line.clear();
+				break;
+			}
+
+			ifstream file(m_OutputDirectory + name, ios::binary);
+			vector<char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+			if(!connection.Write("DATA\t" + to_string(data.size()) + "\n") || !connection.Write(data.data(), data.size()))
+				break;
+		}
+
+		if(isDone && line != "OK")
+			break;
+	}
+
+	context.pCooker->release();
+	FbxFileReader::DestroySdkManager(context.pFbxManager);
+}
@@ -0,0 +1,51 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include "ConversionServer.h"
+
+class TcpConnection;
+
+// Worker of a distributed batch, pulling jobs from a ConversionCoordinator over TCP (see ConversionCoordinator.h for the protocol).
+// Every connection converts a single job at a time, with an fbx manager, cooker & arena of its own that are kept warm between jobs.
+class ConversionWorker final
+{
+public:
+	// * nrOfConnections: nr of jobs converted at once (0 => nr of hardware threads)
+	// * outputDirectory: output path of batch.xml, the names of outputs are sent relative to it
+	// * token: secret shared with the coordinator
+	ConversionWorker(const std::string& host, unsigned short port, unsigned int nrOfConnections, const std::string& outputDirectory, const std::string& token);
+	~ConversionWorker(void);
+
+	// * Converts jobs with handler until the coordinator runs out of jobs. The request is the FbxFile element of the job.
+	void Run(const ConversionServer::RequestHandler& handler);
+
+private:
+	std::string m_Host;
+	unsigned short m_Port;
+	unsigned int m_NrOfConnections;
+	std::string m_OutputDirectory;
+	std::string m_Token;
+
+	void ServeCoordinator(TcpConnection& connection, const ConversionServer::RequestHandler& handler);
+
+	//Disabling copy constructor & assignment operator
+	ConversionWorker(const ConversionWorker& src);
+	ConversionWorker& operator=(const ConversionWorker& src);
+};
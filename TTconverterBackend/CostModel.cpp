@@ -0,0 +1,280 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "CostModel.h"
+
+#include <fstream>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+//Seconds per unit of every term of the model, used as long as no times were recorded
+static const double s_DefaultWeights[] = {
+	0.05,	//Constant: loading the sdk objects & writing the outputs
+	2e-8,	//File size: importing the scene
+	3e-7,	//Polygon vertices: triangulation, extraction, deduplication & welding
+	2e-6,	//Sampled clusters: evaluating bone transforms
+	5e-7,	//Polygon vertices of convex collision: cooking
+	1e-6	//Polygon vertices of concave collision: cooking
+};
+
+//Weight of the default model in the calibration, in nr of recorded conversions
+static const double s_PriorWeight = 1.0;
+
+//Rough nr of bytes per polygon vertex, for files that can't be scanned
+static const double s_BytesPerPolygonVertex = 40.0;
+
+//Binary fbx files consist of nested node records, with a header holding the offset of the next record
+struct NodeHeader{
+	unsigned long long EndOffset;
+	unsigned long long NrOfProperties;
+	unsigned long long PropertyListLength;
+	string Name;
+};
+
+static bool ReadNodeHeader(ifstream& file, bool hasWideOffsets, NodeHeader& header)
+{
+	if(hasWideOffsets){
+		uint64_t fields[3];
+		file.read(reinterpret_cast<char*>(fields), sizeof(fields));
+		header.EndOffset = fields[0];
+		header.NrOfProperties = fields[1];
+		header.PropertyListLength = fields[2];
+	}
+	else{
+		uint32_t fields[3];
+		file.read(reinterpret_cast<char*>(fields), sizeof(fields));
+		header.EndOffset = fields[0];
+		header.NrOfProperties = fields[1];
+		header.PropertyListLength = fields[2];
+	}
+
+	unsigned char nameLength = 0;
+	file.read(reinterpret_cast<char*>(&nameLength), 1);
+	header.Name.resize(nameLength);
+	if(nameLength > 0)
+		file.read(&header.Name[0], nameLength);
+
+	return file.good();
+}
+
+//Reads a string property, or skips a property of another type (returns an empty string)
+static string ReadStringProperty(ifstream& file)
+{
+	char type = 0;
+	file.get(type);
+
+	uint32_t length = 0;
+	switch(type){
+	case 'S': case 'R':
+		file.read(reinterpret_cast<char*>(&length), sizeof(length));
+		if(type == 'S'){
+			string value(length, '\0');
+			if(length > 0)
+				file.read(&value[0], length);
+			return value;
+		}
+		file.seekg(length, ios::cur);
+		break;
+	case 'Y': file.seekg(2, ios::cur); break;
+	case 'C': file.seekg(1, ios::cur); break;
+	case 'I': case 'F': file.seekg(4, ios::cur); break;
+	case 'D': case 'L': file.seekg(8, ios::cur); break;
+	default:
+		//Arrays: length, encoding & nr of stored bytes
+		uint32_t arrayHeader[3] = { 0, 0, 0 };
+		file.read(reinterpret_cast<char*>(arrayHeader), sizeof(arrayHeader));
+		file.seekg(arrayHeader[2], ios::cur);
+	}
+	return string();
+}
+
+//Counts the polygon vertices of the geometry & the skin clusters in a list of records, without reading their data
+static bool ScanNodes(ifstream& file, bool hasWideOffsets, unsigned long long listEnd, const string& parentName, JobFeatures& features)
+{
+	while(static_cast<unsigned long long>(file.tellg()) < listEnd){
+		NodeHeader header;
+		if(!ReadNodeHeader(file, hasWideOffsets, header))
+			return false;
+
+		//A record of zeroes ends the list
+		if(header.EndOffset == 0)
+			return true;
+
+		auto propertiesBegin = static_cast<unsigned long long>(file.tellg());
+		if(header.EndOffset <= propertiesBegin || header.EndOffset > listEnd)
+			return false;
+
+		if(parentName == "Geometry" && header.Name == "PolygonVertexIndex"){
+			char type = 0;
+			uint32_t arrayLength = 0;
+			file.get(type);
+			file.read(reinterpret_cast<char*>(&arrayLength), sizeof(arrayLength));
+			if(type == 'i')
+				features.PolygonVertices += arrayLength;
+		}
+		else if(parentName == "Objects" && header.Name == "Deformer" && header.NrOfProperties >= 3){
+			//Id, name & class of the deformer
+			ReadStringProperty(file);
+			ReadStringProperty(file);
+			if(ReadStringProperty(file) == "Cluster")
+				++features.Clusters;
+		}
+		else if((parentName.empty() && header.Name == "Objects") || (parentName == "Objects" && header.Name == "Geometry")){
+			file.seekg(propertiesBegin + header.PropertyListLength);
+			if(!ScanNodes(file, hasWideOffsets, header.EndOffset, header.Name, features))
+				return false;
+		}
+
+		file.seekg(header.EndOffset);
+	}
+
+	return file.good();
+}
+
+//Constructor & Destructor
+//************************
+
+CostModel::CostModel(const JobHistory* pHistory):m_pHistory(pHistory)
+{
+	copy(begin(s_DefaultWeights), end(s_DefaultWeights), m_Weights);
+
+	if(m_pHistory)
+		Calibrate(m_pHistory->GetRecords());
+}
+
+CostModel::~CostModel(void)
+{}
+
+//Methods
+//*******
+
+JobFeatures CostModel::Scan(const ConversionJob& job)
+{
+	JobFeatures features = { 0, 0, 0, 0, job.GenerateCollision };
+	for(auto& animClip : job.AnimClips)
+		features.Samples += animClip.TransformsAtTimeStamps.size();
+
+	ifstream file(job.InputFilename, ios::binary | ios::ate);
+	if(!file)
+		return features;
+	features.FileSize = static_cast<double>(file.tellg());
+	file.seekg(0);
+
+	//Binary header: magic, followed by the version (offsets are 64 bit from version 7.5 on)
+	char magic[23] = {};
+	uint32_t version = 0;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+
+	if(!file || string(magic, 18) != "Kaydara FBX Binary" || !ScanNodes(file, version >= 7500, static_cast<unsigned long long>(features.FileSize), string(), features)){
+		features.PolygonVertices = features.FileSize / s_BytesPerPolygonVertex;
+		features.Clusters = 0;
+	}
+
+	return features;
+}
+
+void CostModel::GetTerms(const JobFeatures& features, double (&terms)[NrOfTerms])
+{
+	terms[eConstant] = 1;
+	terms[eFileSize] = features.FileSize;
+	terms[ePolygonVertices] = features.PolygonVertices;
+	terms[eSampledClusters] = features.Clusters * features.Samples;
+	terms[eConvexCollision] = features.Collision == CollisionGeneration::Convex ? features.PolygonVertices : 0;
+	terms[eConcaveCollision] = features.Collision == CollisionGeneration::Concave ? features.PolygonVertices : 0;
+}
+
+double CostModel::Estimate(const ConversionJob& job, const JobFeatures& features) const
+{
+	//The same contents with the same settings take as long as they did last time
+	JobRecord record;
+	if(m_pHistory && job.InputHash != 0 && m_pHistory->Find(job.InputFilename, record) && record.InputHash == job.InputHash && record.Seconds >= 0)
+		if(record.Features.Samples == features.Samples && record.Features.Collision == features.Collision)
+			return record.Seconds;
+
+	double terms[NrOfTerms];
+	GetTerms(features, terms);
+
+	double seconds = 0;
+	for(unsigned int i=0; i < NrOfTerms; ++i)
+		seconds += m_Weights[i] * terms[i];
+	return seconds;
+}
+
+void CostModel::Calibrate(const map<string, JobRecord>& records)
+{
+	//Only conversions that were timed count, the scheduler records peaks of jobs without a time
+	vector<const JobRecord*> measurements;
+	for(auto& record : records)
+		if(record.second.Seconds >= 0)
+			measurements.push_back(&record.second);
+
+	if(measurements.empty())
+		return;
+
+	//Least squares fit of the weights to the recorded times, pulled towards the default weights.
+	//The pull of every term is scaled by its typical magnitude, so that the prior counts as s_PriorWeight conversions.
+	double lhs[NrOfTerms][NrOfTerms + 1] = {};
+	double scale[NrOfTerms] = {};
+
+	for(auto pMeasurement : measurements){
+		double terms[NrOfTerms];
+		GetTerms(pMeasurement->Features, terms);
+
+		for(unsigned int i=0; i < NrOfTerms; ++i){
+			scale[i] += terms[i] * terms[i] / measurements.size();
+			for(unsigned int j=0; j < NrOfTerms; ++j)
+				lhs[i][j] += terms[i] * terms[j];
+			lhs[i][NrOfTerms] += terms[i] * pMeasurement->Seconds;
+		}
+	}
+
+	for(unsigned int i=0; i < NrOfTerms; ++i){
+		//Terms that never occurred keep their default weight
+		double prior = s_PriorWeight * max(scale[i], 1e-12);
+		lhs[i][i] += prior;
+		lhs[i][NrOfTerms] += prior * s_DefaultWeights[i];
+	}
+
+	//Gaussian elimination with partial pivoting
+	for(unsigned int col=0; col < NrOfTerms; ++col){
+		unsigned int pivot = col;
+		for(unsigned int row = col + 1; row < NrOfTerms; ++row)
+			if(fabs(lhs[row][col]) > fabs(lhs[pivot][col]))
+				pivot = row;
+		swap(lhs[col], lhs[pivot]);
+
+		if(lhs[col][col] == 0)
+			return;
+
+		for(unsigned int row=0; row < NrOfTerms; ++row){
+			if(row == col)
+				continue;
+			double factor = lhs[row][col] / lhs[col][col];
+			for(unsigned int k = col; k <= NrOfTerms; ++k)
+				lhs[row][k] -= factor * lhs[col][k];
+		}
+	}
+
+	//Negative weights would make larger jobs look cheaper
+	for(unsigned int i=0; i < NrOfTerms; ++i)
+		m_Weights[i] = max(0.0, lhs[i][NrOfTerms] / lhs[i][i]);
+}
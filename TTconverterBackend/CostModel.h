@@ -0,0 +1,60 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include "ConversionJob.h"
+#include "JobHistory.h"
+
+// Estimates the conversion time of jobs, so that the longest jobs can be started first.
+// Features come from a quick scan of the fbx file, the model is calibrated with the times recorded in the job history.
+class CostModel final
+{
+public:
+	// * pHistory: times of earlier conversions (nullptr => uncalibrated model, identical on every machine)
+	CostModel(const JobHistory* pHistory);
+	~CostModel(void);
+
+	// * Reads the features of a job. Binary fbx files are scanned for their polygon & cluster counts without decompressing any data,
+	// * the counts of other files are derived from their size.
+	static JobFeatures Scan(const ConversionJob& job);
+
+	// * Estimated nr of seconds needed to convert the job. A file with the same InputHash & settings as before is estimated by its recorded time.
+	double Estimate(const ConversionJob& job, const JobFeatures& features) const;
+
+private:
+	enum Term{
+		eConstant,
+		eFileSize,
+		ePolygonVertices,
+		eSampledClusters,
+		eConvexCollision,
+		eConcaveCollision,
+		NrOfTerms
+	};
+
+	const JobHistory* m_pHistory;
+	double m_Weights[NrOfTerms];
+
+	static void GetTerms(const JobFeatures& features, double (&terms)[NrOfTerms]);
+	void Calibrate(const std::map<std::string, JobRecord>& records);
+
+	//Disabling copy constructor & assignment operator
+	CostModel(const CostModel& src);
+	CostModel& operator=(const CostModel& src);
+};
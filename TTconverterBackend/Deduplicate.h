@@ -0,0 +1,99 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include "ConversionArena.h"
+#include "FloatTypes.h"
+#include "CancellationToken.h"
+
+template<typename T, typename GetElement>
+// * Removes duplicate elements of the sequence getElement(0) ... getElement(nrOfEntries-1), which is never stored as a whole:
+// * uniqueData receives the distinct elements in order of first occurrence, remap[i] the index of getElement(i) in uniqueData.
+// * If the hash table would exceed the working set limit of the current arena, the elements are hash-partitioned 
+// * and every pass only deduplicates a single partition (getElement is called once per pass). The result is identical either way.
+void Deduplicate(unsigned int nrOfEntries, GetElement getElement, ArenaVector<T>& uniqueData, ArenaVector<unsigned int>& remap)
+{
+	typedef std::unordered_map<T, unsigned int, BitwiseHash<T>, std::equal_to<T>, ArenaAllocator<std::pair<const T, unsigned int> > > HashTable;
+
+	uniqueData.clear();
+	remap.resize(nrOfEntries);
+
+	//Estimated nr of bytes per hash table entry (node, key, value & bucket)
+	const size_t bytesPerEntry = sizeof(T) + sizeof(unsigned int) + 4 * sizeof(void*);
+	auto pArena = ConversionArena::GetCurrent();
+	size_t limit = pArena ? pArena->GetWorkingSetLimit() : 0;
+	const unsigned int nrOfPartitions = limit == 0 ? 1 : static_cast<unsigned int>(std::max<size_t>(1, (nrOfEntries * bytesPerEntry + limit - 1) / limit));
+
+	if(nrOfPartitions == 1){
+		HashTable uniqueIndices;
+		uniqueIndices.reserve(nrOfEntries);
+
+		for(unsigned int i=0; i < nrOfEntries; ++i){
+			if(i % CancellationCheckInterval == 0)
+				CancellationToken::Check();
+
+			//See if we already have an element with this value, new unique elements are added to the unique data array
+			auto result = uniqueIndices.insert(std::make_pair(getElement(i), static_cast<unsigned int>(uniqueData.size())));
+			if(result.second)
+				uniqueData.push_back(result.first->first);
+
+			remap[i] = result.first->second;
+		}
+		return;
+	}
+
+	//Map every element to the position of its first occurrence, one partition per pass
+	BitwiseHash<T> hasher;
+	for(unsigned int iPartition=0; iPartition < nrOfPartitions; ++iPartition){
+		//The table of a pass is freed before the next one, so only a single partition is ever resident
+		ConversionArena tableArena;
+		ArenaScope tableScope(&tableArena);
+
+		HashTable firstOccurrences;
+		firstOccurrences.reserve(nrOfEntries / nrOfPartitions + 1);
+
+		//Partitions use the high bits of the hash, hash tables bucket on the low ones
+		for(unsigned int i=0; i < nrOfEntries; ++i){
+			if(i % CancellationCheckInterval == 0)
+				CancellationToken::Check();
+
+			T element = getElement(i);
+			if((hasher(element) >> 16) % nrOfPartitions == iPartition)
+				remap[i] = firstOccurrences.insert(std::make_pair(element, i)).first->second;
+		}
+	}
+
+	//Turn first occurrences into unique indices in a single sequential pass
+	for(unsigned int i=0; i < nrOfEntries; ++i){
+		if(remap[i] == i){
+			remap[i] = uniqueData.size();
+			uniqueData.push_back(getElement(i));
+		}
+		else
+			remap[i] = remap[remap[i]];
+	}
+}
+
+template<typename T>
+// * Removes duplicate elements: uniqueData receives the distinct elements in order of first occurrence, remap[i] the index of data[i] in uniqueData.
+void Deduplicate(const ArenaVector<T>& data, ArenaVector<T>& uniqueData, ArenaVector<unsigned int>& remap)
+{
+	Deduplicate<T>(data.size(), [&](unsigned int i) -> const T& { return data[i]; }, uniqueData, remap);
+}
@@ -17,36 +17,77 @@
 
 #include "FbxFileReader.h"
 #include <algorithm>
+#include <mutex>
 
 using namespace std;
 
-FbxFileReader::FbxFileReader(const string& filename) : m_pScene(nullptr), m_pSdkManager(nullptr)
+//The fbx sdk isn't documented to be thread-safe. Concurrent jobs use managers & scenes of their own, which share no objects,
+//but creating & destroying managers and scenes and importing go through the sdk's global plugin & io registries, so those are serialized.
+static mutex s_ImportMutex;
+
+FbxFileReader::FbxFileReader(const string& filename, FbxManager* pSdkManager) : m_pScene(nullptr), m_pSdkManager(pSdkManager), m_OwnsSdkManager(pSdkManager == nullptr)
 {
-    // Initialize the resources needed to import fbx files
-    m_pSdkManager = FbxManager::Create();
+	lock_guard<mutex> lock(s_ImportMutex);
+
+    // Initialize the resources needed to import fbx files, unless a manager was passed in that already has them
+    if(m_OwnsSdkManager)
+		m_pSdkManager = FbxManager::Create();
     
-	FbxIOSettings* pIOSettings = FbxIOSettings::Create(m_pSdkManager, IOSROOT);
-    m_pSdkManager->SetIOSettings(pIOSettings);
+	FbxIOSettings* pIOSettings = m_pSdkManager->GetIOSettings();
+	if(!pIOSettings){
+		pIOSettings = FbxIOSettings::Create(m_pSdkManager, IOSROOT);
+		m_pSdkManager->SetIOSettings(pIOSettings);
+	}
 	
 	FbxImporter* pImporter = FbxImporter::Create(m_pSdkManager,"");
-    if( !pImporter->Initialize(filename.c_str(), -1, pIOSettings) )
+    if( !pImporter->Initialize(filename.c_str(), -1, pIOSettings) ){
+		pImporter->Destroy();
+		Release();
         throw exception("Failed to initialize FbxImporter.");
+	}
     
     // Prepare a scene to contain the fbx data
     m_pScene = FbxScene::Create(m_pSdkManager,"myScene");
-    pImporter->Import(m_pScene);
+    bool imported = pImporter->Import(m_pScene);
 
     // Done importing
     pImporter->Destroy();
 
-	//Check if the scene contains a root node
-    if( !m_pScene->GetRootNode() )
-        throw std::exception("No RootNode could be found.");
+	//Check if the scene contains a root node (the destructor doesn't run, so a shared manager would keep the scene forever)
+    if( !imported || !m_pScene->GetRootNode() ){
+		Release();
+        throw exception(imported ? "No RootNode could be found." : "Failed to import the fbx file.");
+	}
 }
 
 FbxFileReader::~FbxFileReader(void)
 {
+	lock_guard<mutex> lock(s_ImportMutex);
+	Release();
+}
+
+FbxManager* FbxFileReader::CreateSdkManager(void)
+{
+	lock_guard<mutex> lock(s_ImportMutex);
+	return FbxManager::Create();
+}
+
+void FbxFileReader::DestroySdkManager(FbxManager* pSdkManager)
+{
+	lock_guard<mutex> lock(s_ImportMutex);
+	pSdkManager->Destroy();
+}
+
+//Destroys the scene and every other object created by the manager, a shared manager only loses our scene. Called with s_ImportMutex locked.
+void FbxFileReader::Release(void)
+{
+	if(m_OwnsSdkManager && m_pSdkManager)
+		m_pSdkManager->Destroy();
+	else if(m_pScene)
+		m_pScene->Destroy();
 
+	m_pSdkManager = nullptr;
+	m_pScene = nullptr;
 }
 
 //Methods
@@ -65,7 +106,7 @@ Mesh& FbxFileReader::GetMesh(const std::string& nodeName)
 		ReadMeshes();
 
 	auto it = find_if(m_Meshes.begin(), m_Meshes.end(), [&](Mesh& meshRef){
-		return meshRef.GetName() == nodeName;
+		return meshRef.Name == nodeName;
 	});
 
 	if(it == m_Meshes.end())
@@ -74,14 +115,28 @@ Mesh& FbxFileReader::GetMesh(const std::string& nodeName)
 	return *it;
 }
 
+vector<Mesh>& FbxFileReader::GetMeshes(void)
+{
+	if(m_Meshes.empty())
+		ReadMeshes();
+
+	return m_Meshes;
+}
+
+vector<Mesh> FbxFileReader::TakeMeshes(void)
+{
+	for(auto& mesh : m_Meshes)
+		mesh.DetachFromScene();
+
+	return move(m_Meshes);
+}
+
 void FbxFileReader::ReadMeshes(void)
 {
     FbxNode* pRootNode = m_pScene->GetRootNode();
 	
-	// Search hierarchy for mesh node
-	int nrOfChildren = pRootNode->GetChildCount();
-	for(int i=0; i<nrOfChildren; ++i)
-		ReadMeshesRecursive(pRootNode);
+	// Search hierarchy for mesh nodes
+	ReadMeshesRecursive(pRootNode);
 	
 	if(m_Meshes.empty())
 		throw exception("Failed to find mesh data.");
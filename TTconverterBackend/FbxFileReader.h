@@ -25,10 +25,15 @@ class FbxFileReader
 {
 public:
 	// * Imports a .fbx file and creates a scene to hold its contents.
-	FbxFileReader(const std::string& filename);
+	// * The scene is created in pSdkManager if given, which stays alive, otherwise in a manager of our own.
+	FbxFileReader(const std::string& filename, FbxManager* pSdkManager = nullptr);
 	virtual ~FbxFileReader(void);
 
 	//Methods
+
+	// * Creates & destroys a manager to pass to readers. Serialized with the imports of other threads, like everything that touches the sdk's registries.
+	static FbxManager* CreateSdkManager(void);
+	static void DestroySdkManager(FbxManager* pSdkManager);
 	
 	// * Retrieves the first MeshNode found in the scene. 
 	// * Throws exception no meshes are found.
@@ -37,14 +42,23 @@ public:
 	// * Retrieves the MeshNode with the given name. 
 	// * Throws exception when mesh is not found.
 	Mesh& GetMesh(const std::string& filename);
+
+	// * Retrieves all MeshNodes found in the scene, in hierarchy order.
+	// * Throws exception no meshes are found.
+	std::vector<Mesh>& GetMeshes(void);
+
+	// * Hands over the meshes read by GetMeshes, detached from the scene so that the reader can be destroyed before them.
+	std::vector<Mesh> TakeMeshes(void);
 	
 private:
 	//Datamembers
 	FbxManager* m_pSdkManager;
 	FbxScene* m_pScene;	
+	bool m_OwnsSdkManager;
 	std::vector<Mesh> m_Meshes;
 
 	void ReadMeshes(void);
+	void Release(void);
 
 	//Recursive function going through the entire FBX node hierarchy looking for mesh nodes
 	void ReadMeshesRecursive(FbxNode* pNode);
@@ -16,15 +16,34 @@
 // along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "FileOutput.h"
+#include <cstdio>
 
 //Create matrix to transform from Max to DX axis system
 FbxAMatrix BinaryWriter::s_MaxToDxMat = FbxAMatrix(FbxVector4(0,0,0,1), FbxVector4(90,0,0,1), FbxVector4(1,1,-1,1));
 
+//Transform a unit axis the same way WriteImpl<FbxVector4> transforms vectors
+static Float3 TransformAxis(const FbxAMatrix& mat, unsigned int axis)
+{
+	FbxVector4 unitAxis(0,0,0,1);
+	unitAxis.mData[axis] = 1;
+
+	FbxAMatrix tmpMat(unitAxis, FbxVector4(0,0,0,1), FbxVector4(1,1,1,1));
+	Float3 result;
+	ConvertAttribute((mat * tmpMat).GetT(), result);
+	return result;
+}
+
+Float3 BinaryWriter::s_MaxToDxAxes[3] = { TransformAxis(s_MaxToDxMat, 0), TransformAxis(s_MaxToDxMat, 1), TransformAxis(s_MaxToDxMat, 2) };
+
 //Constructor & Destructor
 //************************
 
-BinaryWriter::BinaryWriter(const std::string& filename):oFile(filename, std::ios::binary)
-{}
+BinaryWriter::BinaryWriter(const std::string& filename)
+{
+	//Replace rather than overwrite, an existing file may be a hard link into the content store
+	std::remove(filename.c_str());
+	oFile.open(filename, std::ios::binary);
+}
 
 BinaryWriter::~BinaryWriter(void)
 {
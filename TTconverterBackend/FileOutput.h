@@ -20,6 +20,7 @@
 #include <string>
 #include <fstream>
 #include "fbxsdk.h"
+#include "FloatTypes.h"
 
 class BinaryWriter final
 {
@@ -35,12 +36,21 @@ public:
 		WriteImpl<T>::execute(val, oFile);
 	}
 
+	//Nr of bytes written so far
+	unsigned long long GetPosition(void)
+	{
+		return static_cast<unsigned long long>(oFile.tellp());
+	}
+
 private:
 	//filestream
 	std::ofstream oFile;
 
 	//Matrix that can be used to transform matrices and vectors from the 3ds Max axis system to the DirectX axis system (flips z and rotates around x)
 	static FbxAMatrix s_MaxToDxMat;
+
+	//Images of the x, y and z axes under s_MaxToDxMat, to transform compact float vectors without going through FbxAMatrix
+	static Float3 s_MaxToDxAxes[3];
 	
 	//Disabling copy constructor & assignment operator
 	BinaryWriter(const BinaryWriter& src);
@@ -55,66 +65,79 @@ private:
 			oFile.write(reinterpret_cast<const char*>(&val), sizeof(T));
 		}
 	};
-	
-	//WriteImpl specializations
-	//*************************
+};
 
-	template<>
-	struct BinaryWriter::WriteImpl<std::string>
-	{ 
-		static void execute(const std::string& str, std::ofstream& oFile)
-		{
-			auto strLen = (char)str.size();
-			oFile.write(&strLen, 1);
-			oFile.write(str.c_str(), strLen);
-		}
-	};
+//WriteImpl specializations
+//*************************
 
-	template<>
-	struct BinaryWriter::WriteImpl<FbxAMatrix>
-	{ 
-		static void execute(const FbxAMatrix& mat, std::ofstream& oFile)
-		{
-			FbxAMatrix tmp = s_MaxToDxMat * mat;
-			
-			for(unsigned int row=0; row<4; ++row)
-				for(unsigned int col=0; col<3; ++col)
-					WriteImpl<float>::execute(static_cast<float>( tmp.Get(row,col) ), oFile);
-		}
-	};
+template<>
+struct BinaryWriter::WriteImpl<std::string>
+{ 
+	static void execute(const std::string& str, std::ofstream& oFile)
+	{
+		auto strLen = (char)str.size();
+		oFile.write(&strLen, 1);
+		oFile.write(str.c_str(), strLen);
+	}
+};
 
-	template<>
-	struct BinaryWriter::WriteImpl<FbxVector2>
+template<>
+struct BinaryWriter::WriteImpl<FbxAMatrix>
+{ 
+	static void execute(const FbxAMatrix& mat, std::ofstream& oFile)
 	{
-		static void execute(const FbxVector2& vec, std::ofstream& oFile)
-		{
-			WriteImpl<float>::execute(static_cast<float>(vec.mData[0]), oFile);
-			WriteImpl<float>::execute(static_cast<float>(vec.mData[1]), oFile);
-		}
-	};
+		FbxAMatrix tmp = s_MaxToDxMat * mat;
+		
+		for(unsigned int row=0; row<4; ++row)
+			for(unsigned int col=0; col<3; ++col)
+				WriteImpl<float>::execute(static_cast<float>( tmp.Get(row,col) ), oFile);
+	}
+};
 
-	template<>
-	struct BinaryWriter::WriteImpl<FbxVector4>
-	{ 
-		static void execute(const FbxVector4& vec, std::ofstream& oFile)
-		{
-			FbxAMatrix tmpMat(vec, FbxVector4(0,0,0,1), FbxVector4(1,1,1,1));
-			tmpMat = s_MaxToDxMat * tmpMat;
-			WriteImpl<float>::execute(static_cast<float>(tmpMat.GetT().mData[0]), oFile);
-			WriteImpl<float>::execute(static_cast<float>(tmpMat.GetT().mData[1]), oFile);
-			WriteImpl<float>::execute(static_cast<float>(tmpMat.GetT().mData[2]), oFile);
-		}
-	};
+template<>
+struct BinaryWriter::WriteImpl<FbxVector2>
+{
+	static void execute(const FbxVector2& vec, std::ofstream& oFile)
+	{
+		WriteImpl<float>::execute(static_cast<float>(vec.mData[0]), oFile);
+		WriteImpl<float>::execute(static_cast<float>(vec.mData[1]), oFile);
+	}
+};
 
-	template<>
-	struct BinaryWriter::WriteImpl<FbxColor>
-	{ 
-		static void execute(const FbxColor& col, std::ofstream& oFile)
-		{
-			WriteImpl<float>::execute(static_cast<float>(col.mRed)	, oFile);
-			WriteImpl<float>::execute(static_cast<float>(col.mGreen), oFile);
-			WriteImpl<float>::execute(static_cast<float>(col.mBlue)	, oFile);
-			WriteImpl<float>::execute(static_cast<float>(col.mAlpha), oFile);
-		}
-	};
+template<>
+struct BinaryWriter::WriteImpl<FbxVector4>
+{ 
+	static void execute(const FbxVector4& vec, std::ofstream& oFile)
+	{
+		FbxAMatrix tmpMat(vec, FbxVector4(0,0,0,1), FbxVector4(1,1,1,1));
+		tmpMat = s_MaxToDxMat * tmpMat;
+		WriteImpl<float>::execute(static_cast<float>(tmpMat.GetT().mData[0]), oFile);
+		WriteImpl<float>::execute(static_cast<float>(tmpMat.GetT().mData[1]), oFile);
+		WriteImpl<float>::execute(static_cast<float>(tmpMat.GetT().mData[2]), oFile);
+	}
+};
+
+template<>
+struct BinaryWriter::WriteImpl<Float3>
+{ 
+	static void execute(const Float3& vec, std::ofstream& oFile)
+	{
+		Float3 out;
+		out.x = vec.x * s_MaxToDxAxes[0].x + vec.y * s_MaxToDxAxes[1].x + vec.z * s_MaxToDxAxes[2].x;
+		out.y = vec.x * s_MaxToDxAxes[0].y + vec.y * s_MaxToDxAxes[1].y + vec.z * s_MaxToDxAxes[2].y;
+		out.z = vec.x * s_MaxToDxAxes[0].z + vec.y * s_MaxToDxAxes[1].z + vec.z * s_MaxToDxAxes[2].z;
+		oFile.write(reinterpret_cast<const char*>(&out), sizeof(Float3));
+	}
+};
+
+template<>
+struct BinaryWriter::WriteImpl<FbxColor>
+{ 
+	static void execute(const FbxColor& col, std::ofstream& oFile)
+	{
+		WriteImpl<float>::execute(static_cast<float>(col.mRed)	, oFile);
+		WriteImpl<float>::execute(static_cast<float>(col.mGreen), oFile);
+		WriteImpl<float>::execute(static_cast<float>(col.mBlue)	, oFile);
+		WriteImpl<float>::execute(static_cast<float>(col.mAlpha), oFile);
+	}
 };
@@ -0,0 +1,199 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <sys/stat.h>
+
+#ifdef __linux__
+	#include <unistd.h>
+	#include <poll.h>
+	#include <sys/inotify.h>
+#elif defined(_WIN32)
+	#define NOMINMAX
+	#include <windows.h>
+#endif
+
+using namespace std;
+
+#ifndef __linux__
+//Interval at which modification times are checked
+static const unsigned int s_PollMilliseconds = 100;
+#endif
+
+static string GetDirectory(const string& filename)
+{
+	auto iSeparator = filename.find_last_of("/\\");
+	return iSeparator == string::npos ? "." : filename.substr(0, iSeparator);
+}
+
+static string GetLeafName(const string& filename)
+{
+	auto iSeparator = filename.find_last_of("/\\");
+	return iSeparator == string::npos ? filename : filename.substr(iSeparator + 1);
+}
+
+#ifdef __linux__
+
+//Constructor & Destructor
+//************************
+
+FileWatcher::FileWatcher(const vector<string>& filenames):m_Filenames(filenames)
+{
+	m_InotifyDescriptor = inotify_init1(IN_NONBLOCK);
+	if(m_InotifyDescriptor < 0)
+		throw runtime_error("Failed to initialize inotify");
+
+	//Files are written in place or saved to a temporary file and renamed
+	for(auto& filename : m_Filenames){
+		string directory = GetDirectory(filename);
+		int wd = inotify_add_watch(m_InotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if(wd < 0)
+			throw runtime_error("Failed to watch " + directory);
+
+		m_WatchedDirectories.push_back(make_pair(wd, directory));
+	}
+}
+
+FileWatcher::~FileWatcher(void)
+{
+	close(m_InotifyDescriptor);
+}
+
+//Methods
+//*******
+
+vector<unsigned int> FileWatcher::WaitForChanges(unsigned int debounceMilliseconds)
+{
+	vector<unsigned int> changes;
+	
+	while(changes.empty())
+		ReadEvents(-1, changes);
+
+	while(ReadEvents(debounceMilliseconds, changes))
+		;
+
+	sort(changes.begin(), changes.end());
+	changes.erase(unique(changes.begin(), changes.end()), changes.end());
+	return changes;
+}
+
+bool FileWatcher::ReadEvents(int timeoutMilliseconds, vector<unsigned int>& changes)
+{
+	pollfd pfd = { m_InotifyDescriptor, POLLIN, 0 };
+	if(poll(&pfd, 1, timeoutMilliseconds) <= 0)
+		return false;
+
+	alignas(inotify_event) char buffer[4096];
+	ssize_t length;
+	while((length = read(m_InotifyDescriptor, buffer, sizeof(buffer))) > 0){
+		for(char* pCur = buffer; pCur < buffer + length; ){
+			auto pEvent = reinterpret_cast<inotify_event*>(pCur);
+			pCur += sizeof(inotify_event) + pEvent->len;
+
+			if(pEvent->len == 0)
+				continue;
+
+			//Match the event against the files in the watched directory
+			for(unsigned int i=0; i < m_Filenames.size(); ++i)
+				if(m_WatchedDirectories[i].first == pEvent->wd && GetLeafName(m_Filenames[i]) == pEvent->name)
+					changes.push_back(i);
+		}
+	}
+
+	return true;
+}
+
+#else
+
+//Modification time at the file system's full resolution & size of a file, stat's st_mtime only has whole seconds
+//which misses a second save within the same second. (-1, -1) for missing files.
+static pair<long long, long long> GetFileStamp(const string& filename)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if(!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes))
+		return make_pair(-1ll, -1ll);
+
+	return make_pair(static_cast<long long>(attributes.ftLastWriteTime.dwHighDateTime) << 32 | attributes.ftLastWriteTime.dwLowDateTime,
+					 static_cast<long long>(attributes.nFileSizeHigh) << 32 | attributes.nFileSizeLow);
+#else
+	struct stat fileStat;
+	if(stat(filename.c_str(), &fileStat) != 0)
+		return make_pair(-1ll, -1ll);
+
+#ifdef __APPLE__
+	const timespec& modificationTime = fileStat.st_mtimespec;
+#else
+	const timespec& modificationTime = fileStat.st_mtim;
+#endif
+	return make_pair(static_cast<long long>(modificationTime.tv_sec) * 1000000000 + modificationTime.tv_nsec, static_cast<long long>(fileStat.st_size));
+#endif
+}
+
+//Constructor & Destructor
+//************************
+
+FileWatcher::FileWatcher(const vector<string>& filenames):m_Filenames(filenames)
+{
+	for(auto& filename : m_Filenames)
+		m_FileStamps.push_back(GetFileStamp(filename));
+}
+
+FileWatcher::~FileWatcher(void)
+{}
+
+//Methods
+//*******
+
+vector<unsigned int> FileWatcher::WaitForChanges(unsigned int debounceMilliseconds)
+{
+	vector<unsigned int> changes;
+
+	while(!PollChanges(changes))
+		this_thread::sleep_for(chrono::milliseconds(s_PollMilliseconds));
+
+	//Wait until the files are left alone for the debounce period
+	for(auto quietTime = chrono::milliseconds(0); quietTime < chrono::milliseconds(debounceMilliseconds); ){
+		this_thread::sleep_for(chrono::milliseconds(s_PollMilliseconds));
+		quietTime = PollChanges(changes) ? chrono::milliseconds(0) : quietTime + chrono::milliseconds(s_PollMilliseconds);
+	}
+
+	sort(changes.begin(), changes.end());
+	changes.erase(unique(changes.begin(), changes.end()), changes.end());
+	return changes;
+}
+
+bool FileWatcher::PollChanges(vector<unsigned int>& changes)
+{
+	bool changed = false;
+	for(unsigned int i=0; i < m_Filenames.size(); ++i){
+		auto fileStamp = GetFileStamp(m_Filenames[i]);
+		if(fileStamp != m_FileStamps[i]){
+			m_FileStamps[i] = fileStamp;
+			changes.push_back(i);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+#endif
@@ -0,0 +1,53 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Reports changes to a set of files. Uses inotify on Linux, other platforms poll the modification times & sizes.
+// The directories of the files are watched rather than the files themselves, so files replaced by a rename are noticed too.
+class FileWatcher final
+{
+public:
+	FileWatcher(const std::vector<std::string>& filenames);
+	~FileWatcher(void);
+
+	// * Blocks until one of the files changes, then keeps collecting changes until none arrive for debounceMilliseconds.
+	// * Returns the indices of the changed files.
+	std::vector<unsigned int> WaitForChanges(unsigned int debounceMilliseconds);
+
+private:
+	std::vector<std::string> m_Filenames;
+
+#ifdef __linux__
+	int m_InotifyDescriptor;
+	std::vector<std::pair<int, std::string> > m_WatchedDirectories;
+
+	// * Adds the indices of files changed by pending events to changes, waits at most timeoutMilliseconds for events.
+	bool ReadEvents(int timeoutMilliseconds, std::vector<unsigned int>& changes);
+#else
+	std::vector<std::pair<long long, long long> > m_FileStamps; //Modification time & size per file
+
+	bool PollChanges(std::vector<unsigned int>& changes);
+#endif
+
+	//Disabling copy constructor & assignment operator
+	FileWatcher(const FileWatcher& src);
+	FileWatcher& operator=(const FileWatcher& src);
+};
@@ -0,0 +1,92 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <fbxsdk.h>
+
+//Compact single precision vectors, vertex attributes are converted to these straight after extraction
+
+struct Float2{
+	float x, y;
+
+	bool operator==(const Float2& other) const
+	{
+		return x == other.x && y == other.y;
+	}
+};
+
+struct Float3{
+	float x, y, z;
+
+	bool operator==(const Float3& other) const
+	{
+		return x == other.x && y == other.y && z == other.z;
+	}
+};
+
+struct Float4{
+	float x, y, z, w;
+
+	bool operator==(const Float4& other) const
+	{
+		return x == other.x && y == other.y && z == other.z && w == other.w;
+	}
+};
+
+//Narrow to single precision, negative zero is stored as zero so that equal values have equal bit patterns
+inline float ToFloat(double val)
+{
+	float result = static_cast<float>(val);
+	return result == 0 ? 0.0f : result;
+}
+
+//Conversions from the fbx sdk's double precision types
+inline void ConvertAttribute(const FbxVector2& src, Float2& dst)
+{
+	dst.x = ToFloat(src.mData[0]);
+	dst.y = ToFloat(src.mData[1]);
+}
+
+inline void ConvertAttribute(const FbxVector4& src, Float3& dst)
+{
+	dst.x = ToFloat(src.mData[0]);
+	dst.y = ToFloat(src.mData[1]);
+	dst.z = ToFloat(src.mData[2]);
+}
+
+inline void ConvertAttribute(const FbxColor& src, Float4& dst)
+{
+	dst.x = ToFloat(src.mRed);
+	dst.y = ToFloat(src.mGreen);
+	dst.z = ToFloat(src.mBlue);
+	dst.w = ToFloat(src.mAlpha);
+}
+
+template<typename T>
+//FNV-1a hash of the bit pattern of plain-old-data types (packed vertex attributes, vertices)
+struct BitwiseHash{
+	size_t operator()(const T& val) const
+	{
+		const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(&val);
+		size_t hash = 2166136261u;
+		for(size_t i=0; i < sizeof(T); ++i)
+			hash = (hash ^ pBytes[i]) * 16777619u;
+		return hash;
+	}
+};
@@ -0,0 +1,294 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "IntermediateCache.h"
+#include "ContentHash.h"
+#include "ConversionCache.h"
+#include "ScratchFile.h"
+
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+
+using namespace std;
+
+//Increase whenever the layout of the cache files or the data stored in Mesh changes
+static const unsigned int s_CacheVersion = 1;
+static const unsigned int s_CacheMagic = 0x43495454; //"TTIC"
+
+//Raw serialization of the cache files, which are only ever read back on the same platform
+class CacheWriter
+{
+public:
+	CacheWriter(ofstream& file) : m_File(file) {}
+
+	template<typename T>
+	void Write(const T& val){ m_File.write(reinterpret_cast<const char*>(&val), sizeof(T)); }
+
+	void Write(const string& str)
+	{
+		Write<unsigned int>(str.size());
+		m_File.write(str.data(), str.size());
+	}
+
+	template<typename T>
+	void WriteArray(const ArenaVector<T>& arr)
+	{
+		Write<unsigned int>(arr.size());
+		m_File.write(reinterpret_cast<const char*>(arr.data()), arr.size() * sizeof(T));
+	}
+
+private:
+	ofstream& m_File;
+	CacheWriter& operator=(const CacheWriter& src);
+};
+
+//Arrays are read straight into their arena vectors, sizes are checked against the remaining file size before allocating
+class CacheReader
+{
+public:
+	CacheReader(ifstream& file, size_t size) : m_File(file), m_Remaining(size) {}
+
+	template<typename T>
+	T Read(void)
+	{
+		T val;
+		ReadBytes(&val, sizeof(T));
+		return val;
+	}
+
+	string ReadString(void)
+	{
+		string str(ReadCount(1), '\0');
+		ReadBytes(&str[0], str.size());
+		return str;
+	}
+
+	template<typename T>
+	void ReadArray(ArenaVector<T>& arr)
+	{
+		arr.resize(ReadCount(sizeof(T)));
+		ReadBytes(arr.data(), arr.size() * sizeof(T));
+	}
+
+	//Nr of elements of an array that follows, which has to fit in the rest of the file
+	unsigned int ReadCount(size_t elementSize)
+	{
+		unsigned int count = Read<unsigned int>();
+		if(count > m_Remaining / elementSize)
+			throw runtime_error("Truncated cache file");
+
+		return count;
+	}
+
+private:
+	ifstream& m_File;
+	size_t m_Remaining;
+
+	void ReadBytes(void* pOut, size_t size)
+	{
+		if(size > m_Remaining || !m_File.read(static_cast<char*>(pOut), size))
+			throw runtime_error("Truncated cache file");
+
+		m_Remaining -= size;
+	}
+
+	CacheReader& operator=(const CacheReader& src);
+};
+
+template<typename T>
+static void WriteAttribute(CacheWriter& writer, const VertexAttribute<T>& attribute)
+{
+	writer.WriteArray(attribute.data);
+	writer.WriteArray(attribute.indices);
+}
+
+template<typename T>
+static void ReadAttribute(CacheReader& reader, VertexAttribute<T>& attribute)
+{
+	reader.ReadArray(attribute.data);
+	reader.ReadArray(attribute.indices);
+}
+
+//Constructor & Destructor
+//************************
+
+IntermediateCache::IntermediateCache(const string& directory):m_Directory(directory)
+{}
+
+IntermediateCache::~IntermediateCache(void)
+{}
+
+//Methods
+//*******
+
+unsigned long long IntermediateCache::ComputeKey(const ConversionJob& job, const vector<double>& sampleTimes)
+{
+	//The input is only hashed here if incremental conversion didn't do so already
+	unsigned long long inputHash = job.InputHash != 0 ? job.InputHash : ConversionCache::ComputeInputHash(job.InputFilename);
+	if(inputHash == 0)
+		return 0;
+
+	ContentHash hash;
+	hash.Update(s_CacheVersion);
+	hash.Update(inputHash);
+
+	hash.Update(static_cast<unsigned int>(sampleTimes.size()));
+	for(auto time : sampleTimes)
+		hash.Update(time);
+
+	return hash.Get();
+}
+
+string IntermediateCache::GetFilename(unsigned long long key) const
+{
+	return m_Directory + "/" + ContentHash::ToString(key) + ".ttcache";
+}
+
+bool IntermediateCache::Load(unsigned long long key, vector<Mesh>& meshes) const
+{
+	if(!IsEnabled() || key == 0)
+		return false;
+
+	try{
+		ifstream file(GetFilename(key), ios::binary | ios::ate);
+		if(!file)
+			return false;
+
+		size_t size = static_cast<size_t>(file.tellg());
+		file.seekg(0);
+		CacheReader reader(file, size);
+
+		if(reader.Read<unsigned int>() != s_CacheMagic || reader.Read<unsigned int>() != s_CacheVersion)
+			return false;
+
+		meshes.resize(reader.ReadCount(sizeof(unsigned int)));
+		for(auto& mesh : meshes){
+			mesh.Name = reader.ReadString();
+			mesh.GlobalTransform = reader.Read<FbxAMatrix>();
+
+			ReadAttribute(reader, mesh.Positions);
+			ReadAttribute(reader, mesh.TexCoords);
+			ReadAttribute(reader, mesh.Normals);
+			ReadAttribute(reader, mesh.Tangents);
+			ReadAttribute(reader, mesh.Binormals);
+			ReadAttribute(reader, mesh.Colors);
+
+			//Blend information (#, per entry: blend indices & weights)
+			mesh.BlendInformation.data.resize(reader.ReadCount(2 * sizeof(unsigned int)));
+			for(auto& blendInfo : mesh.BlendInformation.data){
+				reader.ReadArray(blendInfo.BlendIndices);
+				reader.ReadArray(blendInfo.BlendWeights);
+			}
+			reader.ReadArray(mesh.BlendInformation.indices);
+
+			//Skeleton (#, names, bindposes), bones are no longer linked to fbx nodes
+			mesh.Skeleton.resize(reader.ReadCount(sizeof(unsigned int) + sizeof(FbxAMatrix)));
+			for(auto& bone : mesh.Skeleton){
+				bone.Name = reader.ReadString();
+				bone.BindPose = reader.Read<FbxAMatrix>();
+				bone.pFbxNode = nullptr;
+				bone.pCluster = nullptr;
+			}
+
+			reader.ReadArray(mesh.TriangleMaterials);
+			mesh.MaterialNames.resize(reader.ReadCount(sizeof(unsigned int)));
+			for(auto& name : mesh.MaterialNames)
+				name = reader.ReadString();
+
+			//Sampled bone transforms (#, time stamp, transforms)
+			unsigned int nrOfTimeStamps = reader.ReadCount(sizeof(double) + sizeof(unsigned int));
+			for(unsigned int i=0; i < nrOfTimeStamps; ++i){
+				double time = reader.Read<double>();
+				reader.ReadArray(mesh.BoneTransformsAtTime[time]);
+			}
+		}
+	}
+	catch(exception&){
+		meshes.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void IntermediateCache::Store(unsigned long long key, const vector<Mesh>& meshes) const
+{
+	if(!IsEnabled() || key == 0)
+		return;
+
+	//Write to a file of our own first, so that concurrent jobs never read a partially written cache file
+	string filename = GetFilename(key);
+	string tmpFilename = ScratchFile::GetTempFilename(filename);
+	bool succeeded = false;
+	{
+		ofstream file(tmpFilename, ios::binary);
+		if(!file)
+			return;
+
+		CacheWriter writer(file);
+		writer.Write(s_CacheMagic);
+		writer.Write(s_CacheVersion);
+
+		writer.Write<unsigned int>(meshes.size());
+		for(auto& mesh : meshes){
+			writer.Write(mesh.Name);
+			writer.Write(mesh.GlobalTransform);
+
+			WriteAttribute(writer, mesh.Positions);
+			WriteAttribute(writer, mesh.TexCoords);
+			WriteAttribute(writer, mesh.Normals);
+			WriteAttribute(writer, mesh.Tangents);
+			WriteAttribute(writer, mesh.Binormals);
+			WriteAttribute(writer, mesh.Colors);
+
+			writer.Write<unsigned int>(mesh.BlendInformation.data.size());
+			for(auto& blendInfo : mesh.BlendInformation.data){
+				writer.WriteArray(blendInfo.BlendIndices);
+				writer.WriteArray(blendInfo.BlendWeights);
+			}
+			writer.WriteArray(mesh.BlendInformation.indices);
+
+			writer.Write<unsigned int>(mesh.Skeleton.size());
+			for(auto& bone : mesh.Skeleton){
+				writer.Write(bone.Name);
+				writer.Write(bone.BindPose);
+			}
+
+			writer.WriteArray(mesh.TriangleMaterials);
+			writer.Write<unsigned int>(mesh.MaterialNames.size());
+			for(auto& name : mesh.MaterialNames)
+				writer.Write(name);
+
+			writer.Write<unsigned int>(mesh.BoneTransformsAtTime.size());
+			for(auto& transformsAtTime : mesh.BoneTransformsAtTime){
+				writer.Write(transformsAtTime.first);
+				writer.WriteArray(transformsAtTime.second);
+			}
+		}
+
+		succeeded = file.good();
+	}
+
+	if(!succeeded){
+		remove(tmpFilename.c_str());
+		return;
+	}
+
+	remove(filename.c_str());
+	rename(tmpFilename.c_str(), filename.c_str());
+}
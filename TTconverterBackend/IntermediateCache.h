@@ -0,0 +1,53 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "VertexAttributes.h"
+#include "ConversionJob.h"
+
+// Binary cache of meshes after extraction, optimization & transform sampling, stored per input hash.
+// A cache hit reads the meshes straight into the arena without going through the fbx sdk.
+class IntermediateCache final
+{
+public:
+	// * Empty directory => caching is disabled.
+	IntermediateCache(const std::string& directory);
+	~IntermediateCache(void);
+
+	bool IsEnabled(void) const { return !m_Directory.empty(); }
+
+	// * Hash of the input file (the job's InputHash if computed), the sampled time stamps and the cache format.
+	static unsigned long long ComputeKey(const ConversionJob& job, const std::vector<double>& sampleTimes);
+
+	// * Restores the meshes stored under key, returns false if there are none (or they're unreadable).
+	bool Load(unsigned long long key, std::vector<Mesh>& meshes) const;
+
+	// * Stores meshes on which ExtractData, Optimize & SampleTransforms have been called.
+	void Store(unsigned long long key, const std::vector<Mesh>& meshes) const;
+
+private:
+	std::string m_Directory;
+
+	std::string GetFilename(unsigned long long key) const;
+
+	//Disabling copy constructor & assignment operator
+	IntermediateCache(const IntermediateCache& src);
+	IntermediateCache& operator=(const IntermediateCache& src);
+};
@@ -0,0 +1,126 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "JobHistory.h"
+#include "ContentHash.h"
+#include "StringUtils.h"
+#include "pugiXML/pugixml.hpp"
+
+#include <iostream>
+
+using namespace std;
+using namespace pugi;
+
+//Constructor & Destructor
+//************************
+
+JobHistory::JobHistory(const string& historyFilename):m_HistoryFilename(historyFilename)
+{
+	xml_document doc;
+	if(doc.load_file(m_HistoryFilename.c_str()).status != status_ok)
+		return;
+
+	for(auto& jobNode : doc.first_child().children(PUGIXML_TEXT("Job"))){
+		JobRecord& record = m_Records[FromXml(jobNode.attribute(PUGIXML_TEXT("File")).value())];
+		record.InputHash = ContentHash::FromString(FromXml(jobNode.attribute(PUGIXML_TEXT("Hash")).value()));
+		record.Features.FileSize = jobNode.attribute(PUGIXML_TEXT("FileSize")).as_double();
+		record.Features.PolygonVertices = jobNode.attribute(PUGIXML_TEXT("PolygonVertices")).as_double();
+		record.Features.Clusters = jobNode.attribute(PUGIXML_TEXT("Clusters")).as_double();
+		record.Features.Samples = jobNode.attribute(PUGIXML_TEXT("Samples")).as_double();
+		record.Features.Collision = static_cast<CollisionGeneration>(jobNode.attribute(PUGIXML_TEXT("Collision")).as_int());
+		record.PeakBytes = jobNode.attribute(PUGIXML_TEXT("PeakBytes")).as_double();
+		record.Seconds = jobNode.attribute(PUGIXML_TEXT("Seconds")).as_double(-1);
+	}
+}
+
+JobHistory::~JobHistory(void)
+{}
+
+//Methods
+//*******
+
+bool JobHistory::Find(const string& inputFilename, JobRecord& record) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	auto it = m_Records.find(inputFilename);
+	if(it == m_Records.end())
+		return false;
+
+	record = it->second;
+	return true;
+}
+
+map<string, JobRecord> JobHistory::GetRecords(void) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+	return m_Records;
+}
+
+JobRecord& JobHistory::GetRecord(const ConversionJob& job)
+{
+	//A record of another version of the input is replaced as a whole
+	auto it = m_Records.find(job.InputFilename);
+	if(it != m_Records.end() && it->second.InputHash == job.InputHash)
+		return it->second;
+
+	JobRecord record = { job.InputHash, { 0, 0, 0, 0, CollisionGeneration::None }, 0, -1 };
+	return m_Records[job.InputFilename] = record;
+}
+
+void JobHistory::RecordPeak(const ConversionJob& job, double fileSize, double peakBytes)
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	JobRecord& record = GetRecord(job);
+	record.Features.FileSize = fileSize;
+	record.PeakBytes = peakBytes;
+}
+
+void JobHistory::RecordTime(const ConversionJob& job, const JobFeatures& features, double seconds)
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	JobRecord& record = GetRecord(job);
+	record.Features = features;
+	record.Seconds = seconds;
+}
+
+void JobHistory::Save(void) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	xml_document doc;
+	auto root = doc.append_child(PUGIXML_TEXT("JobHistory"));
+
+	for(auto& record : m_Records){
+		auto& features = record.second.Features;
+		auto jobNode = root.append_child(PUGIXML_TEXT("Job"));
+		jobNode.append_attribute(PUGIXML_TEXT("File")).set_value(ToXml(record.first).c_str());
+		jobNode.append_attribute(PUGIXML_TEXT("Hash")).set_value(ToXml(ContentHash::ToString(record.second.InputHash)).c_str());
+		jobNode.append_attribute(PUGIXML_TEXT("FileSize")).set_value(features.FileSize);
+		jobNode.append_attribute(PUGIXML_TEXT("PeakBytes")).set_value(record.second.PeakBytes);
+		jobNode.append_attribute(PUGIXML_TEXT("PolygonVertices")).set_value(features.PolygonVertices);
+		jobNode.append_attribute(PUGIXML_TEXT("Clusters")).set_value(features.Clusters);
+		jobNode.append_attribute(PUGIXML_TEXT("Samples")).set_value(features.Samples);
+		jobNode.append_attribute(PUGIXML_TEXT("Collision")).set_value(static_cast<int>(features.Collision));
+		jobNode.append_attribute(PUGIXML_TEXT("Seconds")).set_value(record.second.Seconds);
+	}
+
+	if(!doc.save_file(m_HistoryFilename.c_str()))
+		cout << "Unable to write " << m_HistoryFilename << ".\n";
+}
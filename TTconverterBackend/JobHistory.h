@@ -0,0 +1,72 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include "ConversionJob.h"
+
+//Properties of a job that its conversion time depends on
+struct JobFeatures{
+	double FileSize;
+	double PolygonVertices; //Nr of polygon corners of all meshes
+	double Clusters; //Nr of skin clusters (bones) of all meshes
+	double Samples; //Nr of time stamps of all clips
+	CollisionGeneration Collision;
+};
+
+//What is known about the last conversion of an input file
+struct JobRecord{
+	unsigned long long InputHash; //Hash of the input converted last, 0 => unknown
+	JobFeatures Features;
+	double PeakBytes; //Bytes allocated from the arena + estimated size of the fbx scene, 0 => not recorded
+	double Seconds; //Conversion time, < 0 => not recorded
+};
+
+// Persistent record of earlier conversions per input file, kept between batches.
+// The scheduler uses the recorded peak memory, the cost model the recorded times.
+class JobHistory final
+{
+public:
+	JobHistory(const std::string& historyFilename);
+	~JobHistory(void);
+
+	// * Returns false if the file was never converted before.
+	bool Find(const std::string& inputFilename, JobRecord& record) const;
+	std::map<std::string, JobRecord> GetRecords(void) const;
+
+	// * Records the peak memory of a conversion (done in this process). Thread-safe.
+	void RecordPeak(const ConversionJob& job, double fileSize, double peakBytes);
+
+	// * Records the time a conversion took, wherever it ran. Thread-safe.
+	void RecordTime(const ConversionJob& job, const JobFeatures& features, double seconds);
+
+	void Save(void) const;
+
+private:
+	std::map<std::string, JobRecord> m_Records; //Per input filename
+	std::string m_HistoryFilename;
+	mutable std::mutex m_Mutex;
+
+	JobRecord& GetRecord(const ConversionJob& job);
+
+	//Disabling copy constructor & assignment operator
+	JobHistory(const JobHistory& src);
+	JobHistory& operator=(const JobHistory& src);
+};
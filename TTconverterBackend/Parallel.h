@@ -0,0 +1,116 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ConversionArena.h"
+#include "CancellationToken.h"
+#include "ConversionReport.h"
+
+// * Nr of threads currently spawned by all ParallelFor calls of the process
+inline std::atomic<unsigned int>& GetNrOfParallelThreads(void)
+{
+	static std::atomic<unsigned int> s_NrOfThreads(0);
+	return s_NrOfThreads;
+}
+
+// * Calls func(i) for every i in [begin, end), spread over the available hardware threads.
+// * Rethrows the first exception thrown by any of the calls once all threads have finished.
+// * The calling thread's arena, cancellation token, report and trace job are used by the worker threads as well.
+// * Nested and concurrent calls share the hardware threads, a call only spawns threads while some are left.
+template<typename Func>
+void ParallelFor(unsigned int begin, unsigned int end, Func func)
+{
+	if(begin >= end)
+		return;
+
+	std::atomic<unsigned int> next(begin);
+	std::exception_ptr pError;
+	std::mutex errorMutex;
+	ConversionArena* pArena = ConversionArena::GetCurrent();
+	CancellationToken* pToken = CancellationToken::GetCurrent();
+	ConversionReport* pReport = ConversionReport::GetCurrent();
+	const char* pStage = StageScope::GetCurrent();
+	unsigned int traceJob = Trace::GetCurrentJob();
+
+	//Every thread keeps pulling the next index until the range is exhausted
+	auto worker = [&](){
+		ArenaScope arenaScope(pArena);
+		CancellationScope cancellationScope(pToken);
+		for(unsigned int i = next++; i < end; i = next++){
+			try{
+				func(i);
+			}
+			catch(...){
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if(!pError)
+					pError = std::current_exception();
+			}
+		}
+	};
+
+	//The calling thread takes part, every other thread is claimed from the threads that aren't spawned yet
+	const unsigned int nrOfHardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	const unsigned int nrOfWantedThreads = std::min(nrOfHardwareThreads, end - begin);
+	auto& nrOfSpawnedThreads = GetNrOfParallelThreads();
+	unsigned int nrOfThreads = 1;
+	for(unsigned int spawned = nrOfSpawnedThreads.load(); nrOfThreads < nrOfWantedThreads && spawned + 1 < nrOfHardwareThreads; )
+		if(nrOfSpawnedThreads.compare_exchange_weak(spawned, spawned + 1))
+			++nrOfThreads;
+
+	std::vector<std::thread> threads;
+	for(unsigned int i=1; i < nrOfThreads; ++i)
+		threads.emplace_back([&](){
+			//Cpu time of the other threads counts towards the stage of the calling thread, their hardware counts are included in its counters
+			ReportScope reportScope(pReport);
+			TraceJobScope traceJobScope(traceJob);
+			if(pStage)
+				PerfCounters::CountInSpawningThread();
+			StageScope stageScope(pStage);
+			worker();
+		});
+
+	worker();
+	for(auto& thread : threads)
+		thread.join();
+	nrOfSpawnedThreads -= nrOfThreads - 1;
+
+	if(pError)
+		std::rethrow_exception(pError);
+}
+
+// * Calls func(rangeBegin, rangeEnd) for consecutive ranges of at most grainSize elements covering [begin, end), in parallel.
+template<typename Func>
+void ParallelForRange(unsigned int begin, unsigned int end, unsigned int grainSize, Func func)
+{
+	if(begin >= end)
+		return;
+
+	const unsigned int nrOfRanges = (end - begin - 1) / grainSize + 1;
+	ParallelFor(0, nrOfRanges, [&](unsigned int iRange){
+		unsigned int rangeBegin = begin + iRange * grainSize;
+		func(rangeBegin, rangeBegin + std::min(grainSize, end - rangeBegin));
+	});
+}
+
@@ -0,0 +1,171 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "PerfCounters.h"
+
+#include <iostream>
+
+#ifdef __linux__
+	#include <unistd.h>
+	#include <cstring>
+	#include <cerrno>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <linux/perf_event.h>
+#endif
+
+using namespace std;
+
+atomic<bool> PerfCounters::s_IsEnabled(false);
+thread_local bool PerfCounters::s_IsCountedBySpawner = false;
+
+static const char* s_CounterNames[] = { "Cycles", "Instructions", "CacheMisses", "BranchMisses" };
+
+#ifdef __linux__
+
+static const unsigned long long s_CounterConfigs[] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+//Counter group of a single thread & the threads it spawns, closed when the thread ends
+class ThreadCounters final
+{
+public:
+	ThreadCounters(void):m_Error(0)
+	{
+		for(auto& fd : m_Fds)
+			fd = -1;
+
+		for(unsigned int i=0; i < PerfCounters::NrOfCounters; ++i){
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = s_CounterConfigs[i];
+			attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			attr.disabled = i == 0 ? 1 : 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.inherit = 1;
+
+			//Calling thread on any cpu, the first counter leads the group
+			m_Fds[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : m_Fds[0], 0));
+			if(m_Fds[i] < 0){
+				m_Error = errno;
+				Close();
+				return;
+			}
+		}
+
+		ioctl(m_Fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	~ThreadCounters(void)
+	{
+		Close();
+	}
+
+	bool IsOpen(void) const { return m_Fds[0] >= 0; }
+	int GetError(void) const { return m_Error; }
+
+	bool Read(PerfCounters::Sample& sample)
+	{
+		//Nr of counters, time enabled, time running, counts
+		unsigned long long data[3 + PerfCounters::NrOfCounters];
+		if(!IsOpen() || read(m_Fds[0], data, sizeof(data)) != sizeof(data) || data[0] != PerfCounters::NrOfCounters)
+			return false;
+
+		sample.TimeEnabled = data[1];
+		sample.TimeRunning = data[2];
+		for(unsigned int i=0; i < PerfCounters::NrOfCounters; ++i)
+			sample.Counts[i] = data[3 + i];
+		return true;
+	}
+
+private:
+	int m_Fds[PerfCounters::NrOfCounters];
+	int m_Error;
+
+	void Close(void)
+	{
+		for(auto& fd : m_Fds){
+			if(fd >= 0)
+				close(fd);
+			fd = -1;
+		}
+	}
+
+	//Disabling copy constructor & assignment operator
+	ThreadCounters(const ThreadCounters& src);
+	ThreadCounters& operator=(const ThreadCounters& src);
+};
+
+static thread_local ThreadCounters s_ThreadCounters;
+
+#endif
+
+//Methods
+//*******
+
+bool PerfCounters::Enable(void)
+{
+#ifdef __linux__
+	//Probe with counters of our own, those of the calling thread would be inherited by every thread it spawns from now on
+	ThreadCounters probe;
+	if(!probe.IsOpen()){
+		cout << "Hardware performance counters are unavailable: " << strerror(probe.GetError()) << ".\n";
+		return false;
+	}
+
+	s_IsEnabled = true;
+	return true;
+#else
+	cout << "Hardware performance counters are only supported on Linux.\n";
+	return false;
+#endif
+}
+
+bool PerfCounters::Read(Sample& sample)
+{
+	if(s_IsCountedBySpawner)
+		return false;
+
+#ifdef __linux__
+	return s_ThreadCounters.Read(sample);
+#else
+	return false;
+#endif
+}
+
+void PerfCounters::GetCounts(const Sample& begin, const Sample& end, double (&counts)[NrOfCounters])
+{
+	//Scale the differences, scaled totals can decrease from one sample to the next
+	unsigned long long timeEnabled = end.TimeEnabled - begin.TimeEnabled;
+	unsigned long long timeRunning = end.TimeRunning - begin.TimeRunning;
+	double scale = timeRunning > 0 && timeRunning < timeEnabled ? static_cast<double>(timeEnabled) / timeRunning : 1.0;
+
+	for(unsigned int i=0; i < NrOfCounters; ++i)
+		counts[i] = static_cast<double>(end.Counts[i] - begin.Counts[i]) * scale;
+}
+
+void PerfCounters::CountInSpawningThread(void)
+{
+	s_IsCountedBySpawner = true;
+}
+
+const char* PerfCounters::GetName(Counter counter)
+{
+	return s_CounterNames[counter];
+}
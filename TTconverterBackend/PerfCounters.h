@@ -0,0 +1,71 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+
+// Hardware performance counters of the calling thread, read through perf_event_open on Linux.
+// A thread opens its counters on first use, they're inherited by the threads it spawns afterwards: the counts of those are included
+// in its own, so the threads ParallelFor spawns inside a stage don't open counters of their own. Stage scopes add the counts of their block to their stage while enabled.
+class PerfCounters final
+{
+public:
+	enum Counter{
+		eCycles,
+		eInstructions,
+		eCacheMisses,
+		eBranchMisses,
+		NrOfCounters
+	};
+
+	//Raw counts & the times the counters were enabled & actually counting, the kernel multiplexes them when it runs out of hardware counters
+	struct Sample{
+		unsigned long long TimeEnabled;
+		unsigned long long TimeRunning;
+		unsigned long long Counts[NrOfCounters];
+	};
+
+	// * Starts counting, returns false if the counters are unavailable (other platforms, or denied by perf_event_paranoid).
+	static bool Enable(void);
+
+	static bool IsEnabled(void)
+	{
+		return s_IsEnabled.load(std::memory_order_relaxed);
+	}
+
+	// * Counts of the calling thread & the threads it spawned since its counters were opened. Returns false if they can't be read,
+	// * or if the calling thread is counted by the thread that spawned it.
+	static bool Read(Sample& sample);
+
+	// * Counts between two samples, scaled up by the share of the time the counters were actually counting in between.
+	static void GetCounts(const Sample& begin, const Sample& end, double (&counts)[NrOfCounters]);
+
+	// * Marks the calling thread as counted by the inherited counters of the thread that spawned it. For threads spawned inside a stage.
+	static void CountInSpawningThread(void);
+
+	static const char* GetName(Counter counter);
+
+private:
+	static std::atomic<bool> s_IsEnabled;
+	static thread_local bool s_IsCountedBySpawner;
+
+	//Disabling default constructor, copy constructor & assignment operator
+	PerfCounters(void);
+	PerfCounters(const PerfCounters& src);
+	PerfCounters& operator=(const PerfCounters& src);
+};
@@ -0,0 +1,130 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ScratchFile.h"
+
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <vector>
+	#include <cstdlib>
+	#include <unistd.h>
+	#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+//Constructor & Destructor
+//************************
+
+#ifdef _WIN32
+
+ScratchFile::ScratchFile(const string& directory, size_t size):m_pData(nullptr), m_Size(size), m_hFile(INVALID_HANDLE_VALUE), m_hMapping(nullptr)
+{
+	char filename[MAX_PATH];
+	if(!GetTempFileNameA(directory.empty() ? "." : directory.c_str(), "tt", 0, filename))
+		throw runtime_error("Failed to create scratch file in " + directory);
+
+	//The file is only written back to disk under memory pressure and disappears when closed
+	m_hFile = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if(m_hFile == INVALID_HANDLE_VALUE)
+		throw runtime_error(string("Failed to open scratch file ") + filename);
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<unsigned long long>(size) >> 32), static_cast<DWORD>(size), nullptr);
+	m_pData = m_hMapping ? static_cast<char*>(MapViewOfFile(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, size)) : nullptr;
+	
+	if(!m_pData){
+		if(m_hMapping)
+			CloseHandle(m_hMapping);
+		CloseHandle(m_hFile);
+		throw runtime_error(string("Failed to map scratch file ") + filename);
+	}
+}
+
+ScratchFile::~ScratchFile(void)
+{
+	UnmapViewOfFile(m_pData);
+	CloseHandle(m_hMapping);
+	CloseHandle(m_hFile);
+}
+
+//Methods
+//*******
+
+void ScratchFile::Evict(void)
+{
+	//Unlocking pages that aren't locked trims them from the working set, modified pages are written to the file
+	VirtualUnlock(m_pData, m_Size);
+}
+
+#else
+
+ScratchFile::ScratchFile(const string& directory, size_t size):m_pData(nullptr), m_Size(size), m_FileDescriptor(-1)
+{
+	string pattern = (directory.empty() ? string(".") : directory) + "/ttscratchXXXXXX";
+	vector<char> filename(pattern.begin(), pattern.end());
+	filename.push_back('\0');
+
+	m_FileDescriptor = mkstemp(filename.data());
+	if(m_FileDescriptor < 0)
+		throw runtime_error("Failed to create scratch file in " + directory);
+
+	//The file disappears as soon as it's closed
+	unlink(filename.data());
+
+	void* pData = MAP_FAILED;
+	if(ftruncate(m_FileDescriptor, size) == 0)
+		pData = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_FileDescriptor, 0);
+	
+	if(pData == MAP_FAILED){
+		close(m_FileDescriptor);
+		throw runtime_error("Failed to map scratch file in " + directory);
+	}
+
+	m_pData = static_cast<char*>(pData);
+}
+
+ScratchFile::~ScratchFile(void)
+{
+	munmap(m_pData, m_Size);
+	close(m_FileDescriptor);
+}
+
+//Methods
+//*******
+
+void ScratchFile::Evict(void)
+{
+	//Pages of a shared file mapping are repopulated from the file on the next access
+	madvise(m_pData, m_Size, MADV_DONTNEED);
+}
+
+#endif
+
+string ScratchFile::GetTempFilename(const string& filename)
+{
+	//Shards, pool workers & watching converters may write the same file, the thread id alone is only unique within a process
+#ifdef _WIN32
+	unsigned long processId = GetCurrentProcessId();
+#else
+	long processId = static_cast<long>(getpid());
+#endif
+	return filename + "." + to_string(processId) + "." + to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp";
+}
@@ -0,0 +1,55 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+
+// Temporary file mapped into memory, deleted when the object is destroyed.
+// Used as backing store for data that may not fit in RAM: the os pages it out to the file instead of running out of memory.
+class ScratchFile final
+{
+public:
+	ScratchFile(const std::string& directory, size_t size);
+	~ScratchFile(void);
+
+	char* GetData(void) const { return m_pData; }
+	size_t GetSize(void) const { return m_Size; }
+
+	// * Removes the mapped pages from the working set of the process, their contents are kept in the file.
+	// * The data stays valid, pages that are accessed again are paged back in.
+	void Evict(void);
+
+	// * Name of a temporary file next to filename that no other process or thread writes to at the same time.
+	// * Files are written under this name first and renamed over filename, so that they never exist half-written.
+	static std::string GetTempFilename(const std::string& filename);
+
+private:
+	char* m_pData;
+	size_t m_Size;
+
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_FileDescriptor;
+#endif
+
+	//Disabling copy constructor & assignment operator
+	ScratchFile(const ScratchFile& src);
+	ScratchFile& operator=(const ScratchFile& src);
+};
@@ -0,0 +1,248 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ShardReport.h"
+#include "CostModel.h"
+#include "StringUtils.h"
+#include "pugiXML/pugixml.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <map>
+
+using namespace std;
+using namespace pugi;
+
+static const char_t* s_StatusNames[] = { PUGIXML_TEXT("Converted"), PUGIXML_TEXT("UpToDate"), PUGIXML_TEXT("Failed"), PUGIXML_TEXT("Cancelled") };
+
+//Constructor & Destructor
+//************************
+
+ShardReport::ShardReport(unsigned int shardIndex, unsigned int shardCount):m_ShardIndex(shardIndex), m_ShardCount(shardCount)
+{}
+
+ShardReport::~ShardReport(void)
+{}
+
+//Methods
+//*******
+
+vector<unsigned int> ShardReport::AssignShards(const vector<ConversionJob>& jobs, unsigned int shardCount)
+{
+	CostModel costModel(nullptr);
+	vector<double> costs;
+	for(auto& job : jobs)
+		costs.push_back(costModel.Estimate(job, CostModel::Scan(job)));
+
+	//Every shard must come to the same assignment, ties are broken on the filenames
+	vector<unsigned int> order(jobs.size());
+	iota(order.begin(), order.end(), 0);
+	sort(order.begin(), order.end(), [&](unsigned int lhs, unsigned int rhs){
+		if(costs[lhs] != costs[rhs])
+			return costs[lhs] > costs[rhs];
+		if(jobs[lhs].InputFilename != jobs[rhs].InputFilename)
+			return jobs[lhs].InputFilename < jobs[rhs].InputFilename;
+		return lhs < rhs;
+	});
+
+	vector<unsigned int> shards(jobs.size());
+	vector<double> load(shardCount, 0);
+	for(auto iJob : order){
+		unsigned int iShard = min_element(load.begin(), load.end()) - load.begin();
+		shards[iJob] = iShard;
+		load[iShard] += costs[iJob];
+	}
+
+	return shards;
+}
+
+void ShardReport::SavePlan(const string& filename, const vector<ConversionJob>& jobs, const vector<unsigned int>& shards, unsigned int shardCount)
+{
+	xml_document doc;
+	auto root = doc.append_child(PUGIXML_TEXT("ShardPlan"));
+	root.append_attribute(PUGIXML_TEXT("ShardCount")).set_value(shardCount);
+
+	for(unsigned int iJob=0; iJob < jobs.size(); ++iJob){
+		auto jobNode = root.append_child(PUGIXML_TEXT("Job"));
+		jobNode.append_attribute(PUGIXML_TEXT("Input")).set_value(ToXml(jobs[iJob].InputFilename).c_str());
+		jobNode.append_attribute(PUGIXML_TEXT("Output")).set_value(ToXml(jobs[iJob].OutputFilename).c_str());
+		jobNode.append_attribute(PUGIXML_TEXT("Shard")).set_value(shards[iJob]);
+	}
+
+	if(!doc.save_file(filename.c_str()))
+		cout << "Unable to write " << filename << ".\n";
+}
+
+bool ShardReport::LoadPlan(const string& filename, const vector<ConversionJob>& jobs, unsigned int shardCount, vector<unsigned int>& shards)
+{
+	xml_document doc;
+	if(doc.load_file(filename.c_str()).status != status_ok){
+		cout << "Unable to read " << filename << ".\n";
+		return false;
+	}
+
+	auto root = doc.child(PUGIXML_TEXT("ShardPlan"));
+	if(root.attribute(PUGIXML_TEXT("ShardCount")).as_uint() != shardCount){
+		cout << filename << " was planned for another nr of shards.\n";
+		return false;
+	}
+
+	//Jobs are identified by their input & output
+	map<pair<string, string>, unsigned int> shardPerJob;
+	for(auto& jobNode : root.children(PUGIXML_TEXT("Job"))){
+		auto key = make_pair(FromXml(jobNode.attribute(PUGIXML_TEXT("Input")).value()), FromXml(jobNode.attribute(PUGIXML_TEXT("Output")).value()));
+		shardPerJob[key] = jobNode.attribute(PUGIXML_TEXT("Shard")).as_uint();
+	}
+
+	shards.clear();
+	for(auto& job : jobs){
+		auto it = shardPerJob.find(make_pair(job.InputFilename, job.OutputFilename));
+		if(it == shardPerJob.end() || it->second >= shardCount){
+			cout << filename << " has no valid shard for " << job.InputFilename << ".\n";
+			return false;
+		}
+		shards.push_back(it->second);
+	}
+
+	return true;
+}
+
+void ShardReport::Record(const ConversionJob& job, JobStatus status, const vector<string>& outputFiles)
+{
+	Entry entry = { job.InputFilename, job.OutputFilename, status, outputFiles };
+
+	lock_guard<mutex> lock(m_Mutex);
+	m_Entries.push_back(entry);
+}
+
+void ShardReport::Save(const string& filename) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	xml_document doc;
+	auto root = doc.append_child(PUGIXML_TEXT("ShardReport"));
+	root.append_attribute(PUGIXML_TEXT("Shard")).set_value(m_ShardIndex);
+	root.append_attribute(PUGIXML_TEXT("ShardCount")).set_value(m_ShardCount);
+
+	for(auto& entry : m_Entries){
+		auto jobNode = root.append_child(PUGIXML_TEXT("Job"));
+		jobNode.append_attribute(PUGIXML_TEXT("Input")).set_value(ToXml(entry.InputFilename).c_str());
+		jobNode.append_attribute(PUGIXML_TEXT("Output")).set_value(ToXml(entry.OutputFilename).c_str());
+		jobNode.append_attribute(PUGIXML_TEXT("Status")).set_value(s_StatusNames[static_cast<int>(entry.Status)]);
+
+		for(auto& outputFile : entry.OutputFiles)
+			jobNode.append_child(PUGIXML_TEXT("File")).append_attribute(PUGIXML_TEXT("Name")).set_value(ToXml(outputFile).c_str());
+	}
+
+	if(!doc.save_file(filename.c_str()))
+		cout << "Unable to write " << filename << ".\n";
+}
+
+bool ShardReport::Merge(const vector<string>& reportFilenames, const vector<ConversionJob>& jobs, const string& mergedFilename)
+{
+	bool isComplete = true;
+	unsigned int shardCount = 0;
+	vector<bool> isShardReported;
+
+	//Nr of times every job of the batch was reported, jobs are identified by their input & output
+	map<pair<string, string>, unsigned int> nrOfReports;
+	for(auto& job : jobs)
+		nrOfReports[make_pair(job.InputFilename, job.OutputFilename)] = 0;
+
+	xml_document mergedDoc;
+	auto mergedRoot = mergedDoc.append_child(PUGIXML_TEXT("BatchReport"));
+
+	for(auto& reportFilename : reportFilenames){
+		xml_document doc;
+		if(doc.load_file(reportFilename.c_str()).status != status_ok){
+			cout << "Unable to read " << reportFilename << ".\n";
+			isComplete = false;
+			continue;
+		}
+
+		auto root = doc.child(PUGIXML_TEXT("ShardReport"));
+		unsigned int shardIndex = root.attribute(PUGIXML_TEXT("Shard")).as_uint();
+		
+		if(shardCount == 0){
+			shardCount = root.attribute(PUGIXML_TEXT("ShardCount")).as_uint();
+			isShardReported.assign(shardCount, false);
+		}
+
+		if(root.attribute(PUGIXML_TEXT("ShardCount")).as_uint() != shardCount || shardIndex >= shardCount){
+			cout << reportFilename << " doesn't belong to this set of shards.\n";
+			isComplete = false;
+			continue;
+		}
+
+		if(isShardReported[shardIndex]){
+			cout << "Shard " << shardIndex << " is reported more than once.\n";
+			isComplete = false;
+			continue;
+		}
+		isShardReported[shardIndex] = true;
+
+		for(auto& jobNode : root.children(PUGIXML_TEXT("Job"))){
+			auto key = make_pair(FromXml(jobNode.attribute(PUGIXML_TEXT("Input")).value()), FromXml(jobNode.attribute(PUGIXML_TEXT("Output")).value()));
+			auto it = nrOfReports.find(key);
+			
+			if(it == nrOfReports.end()){
+				cout << key.first << " isn't part of the batch, but was converted by shard " << shardIndex << ".\n";
+				isComplete = false;
+			}
+			else if(++it->second > 1){
+				cout << key.first << " was converted by more than one shard.\n";
+				isComplete = false;
+			}
+
+			string_t status = jobNode.attribute(PUGIXML_TEXT("Status")).value();
+			if(status == s_StatusNames[static_cast<int>(JobStatus::Failed)]){
+				cout << "Conversion of " << key.first << " failed in shard " << shardIndex << ".\n";
+				isComplete = false;
+			}
+			else if(status == s_StatusNames[static_cast<int>(JobStatus::Cancelled)]){
+				cout << "Conversion of " << key.first << " ran out of time in shard " << shardIndex << ".\n";
+				isComplete = false;
+			}
+
+			auto mergedNode = mergedRoot.append_copy(jobNode);
+			mergedNode.append_attribute(PUGIXML_TEXT("Shard")).set_value(shardIndex);
+		}
+	}
+
+	for(unsigned int iShard=0; iShard < shardCount; ++iShard)
+		if(!isShardReported[iShard]){
+			cout << "Report of shard " << iShard << " is missing.\n";
+			isComplete = false;
+		}
+
+	for(auto& reportCount : nrOfReports)
+		if(reportCount.second == 0){
+			cout << reportCount.first.first << " wasn't converted by any shard.\n";
+			isComplete = false;
+		}
+
+	mergedRoot.append_attribute(PUGIXML_TEXT("ShardCount")).set_value(shardCount);
+	mergedRoot.append_attribute(PUGIXML_TEXT("Complete")).set_value(isComplete);
+
+	if(!mergedDoc.save_file(mergedFilename.c_str())){
+		cout << "Unable to write " << mergedFilename << ".\n";
+		return false;
+	}
+
+	return isComplete;
+}
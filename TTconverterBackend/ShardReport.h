@@ -0,0 +1,74 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "ConversionJob.h"
+
+enum class JobStatus{
+	Converted,
+	UpToDate,
+	Failed,
+	Cancelled //Ran out of time
+};
+
+// Splits a batch over several processes or machines, and records what a single shard did with its jobs.
+// The reports of all shards are merged into a single report, which also verifies that every job of the batch was handled by exactly one shard.
+class ShardReport final
+{
+public:
+	ShardReport(unsigned int shardIndex, unsigned int shardCount);
+	~ShardReport(void);
+
+	// * Index of the shard that converts every job, the largest jobs are spread first and each job goes to the least loaded shard.
+	// * Deterministic, so shards with identical input files come to the same assignment on their own. Costs come from scanning
+	// * the local input files, machines with different checkouts are handed a plan computed once instead (SavePlan/LoadPlan).
+	static std::vector<unsigned int> AssignShards(const std::vector<ConversionJob>& jobs, unsigned int shardCount);
+
+	static void SavePlan(const std::string& filename, const std::vector<ConversionJob>& jobs, const std::vector<unsigned int>& shards, unsigned int shardCount);
+
+	// * Reads the shard of every job from a plan. Returns false if the plan is unreadable, was made for another shard count or lacks a job of the batch.
+	static bool LoadPlan(const std::string& filename, const std::vector<ConversionJob>& jobs, unsigned int shardCount, std::vector<unsigned int>& shards);
+
+	// * Records the result of a job. Thread-safe.
+	void Record(const ConversionJob& job, JobStatus status, const std::vector<std::string>& outputFiles);
+
+	void Save(const std::string& filename) const;
+
+	// * Combines the reports of all shards of the batch into mergedFilename.
+	// * Returns false if a shard report is missing, or a job of the batch failed, was cancelled, wasn't handled or was handled more than once.
+	static bool Merge(const std::vector<std::string>& reportFilenames, const std::vector<ConversionJob>& jobs, const std::string& mergedFilename);
+
+private:
+	struct Entry{
+		std::string InputFilename;
+		std::string OutputFilename;
+		JobStatus Status;
+		std::vector<std::string> OutputFiles;
+	};
+
+	std::vector<Entry> m_Entries;
+	unsigned int m_ShardIndex, m_ShardCount;
+	mutable std::mutex m_Mutex;
+
+	//Disabling copy constructor & assignment operator
+	ShardReport(const ShardReport& src);
+	ShardReport& operator=(const ShardReport& src);
+};
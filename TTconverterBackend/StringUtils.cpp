@@ -0,0 +1,66 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "StringUtils.h"
+
+#include <sstream>
+
+using namespace std;
+using namespace pugi;
+
+string ToJson(const string& str)
+{
+	ostringstream json;
+	json << '"';
+	for(auto c : str){
+		switch(c){
+		case '"': json << "\\\""; break;
+		case '\\': json << "\\\\"; break;
+		case '\n': json << "\\n"; break;
+		case '\r': json << "\\r"; break;
+		case '\t': json << "\\t"; break;
+		default:
+			if(static_cast<unsigned char>(c) < 0x20)
+				json << "\\u00" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 0xf];
+			else
+				json << c;
+		}
+	}
+	json << '"';
+	return json.str();
+}
+
+string_t ToXml(const string& str)
+{
+	return string_t(str.begin(), str.end());
+}
+
+string FromXml(const char_t* str)
+{
+	string_t xmlStr(str);
+	return string(xmlStr.begin(), xmlStr.end());
+}
+
+vector<string> SplitFields(const string& line)
+{
+	vector<string> fields;
+	istringstream stream(line);
+	string field;
+	while(getline(stream, field, '\t'))
+		fields.push_back(field);
+	return fields;
+}
@@ -0,0 +1,34 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "pugiXML/pugixml.hpp"
+
+// Conversions between the strings of the converter and the formats of its files & protocols.
+
+// * Quoted JSON string, with quotes, backslashes & control characters escaped.
+std::string ToJson(const std::string& str);
+
+// * Strings of pugixml, which may be wide. Filenames & hashes are plain ASCII.
+pugi::string_t ToXml(const std::string& str);
+std::string FromXml(const pugi::char_t* str);
+
+// * Fields of a tab-separated protocol line.
+std::vector<std::string> SplitFields(const std::string& line);
@@ -0,0 +1,239 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TcpConnection.h"
+
+#include <stdexcept>
+#include <mutex>
+#include <algorithm>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <WinSock2.h>
+	#include <WS2tcpip.h>
+	typedef int ssize_t;
+#else
+	#include <unistd.h>
+	#include <signal.h>
+	#include <netdb.h>
+	#include <sys/socket.h>
+	#include <sys/select.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#define INVALID_SOCKET (-1)
+	#define closesocket close
+#endif
+
+using namespace std;
+
+//Size of the chunks data is received in
+static const size_t s_ReceiveChunkSize = 64 * 1024;
+
+//Max length of a line, a peer that sends more without a newline is treated as lost
+static const size_t s_MaxLineLength = 16 * 1024 * 1024;
+
+//Seconds of silence before keepalive probes are sent, seconds between probes & nr of unanswered probes before the connection is dropped
+static const int s_KeepAliveIdleSeconds = 60;
+static const int s_KeepAliveIntervalSeconds = 10;
+static const int s_KeepAliveProbeCount = 6;
+
+//Winsock has to be started once per process, and a lost peer mustn't raise SIGPIPE elsewhere
+static void InitializeSockets(void)
+{
+	static once_flag s_Initialized;
+	call_once(s_Initialized, []{
+#ifdef _WIN32
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+#else
+		signal(SIGPIPE, SIG_IGN);
+#endif
+	});
+}
+
+//Constructor & Destructor
+//************************
+
+TcpConnection::TcpConnection(Socket socket):m_Socket(socket)
+{
+	//Lines are small & answered right away, don't hold them back
+	int noDelay = 1;
+	setsockopt(m_Socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+}
+
+TcpConnection::~TcpConnection(void)
+{
+	closesocket(m_Socket);
+}
+
+TcpListener::TcpListener(const string& address, unsigned short port)
+{
+	InitializeSockets();
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo* pAddresses = nullptr;
+	if(getaddrinfo(address.c_str(), to_string(port).c_str(), &hints, &pAddresses) != 0)
+		throw runtime_error("Failed to resolve " + address);
+
+	m_Socket = socket(pAddresses->ai_family, pAddresses->ai_socktype, pAddresses->ai_protocol);
+	if(m_Socket == INVALID_SOCKET){
+		freeaddrinfo(pAddresses);
+		throw runtime_error("Failed to create socket");
+	}
+
+	int reuseAddress = 1;
+	setsockopt(m_Socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress));
+
+	bool isListening = ::bind(m_Socket, pAddresses->ai_addr, static_cast<int>(pAddresses->ai_addrlen)) == 0 && listen(m_Socket, SOMAXCONN) == 0;
+	freeaddrinfo(pAddresses);
+	if(!isListening){
+		closesocket(m_Socket);
+		throw runtime_error("Failed to listen on " + address + ":" + to_string(port));
+	}
+}
+
+TcpListener::~TcpListener(void)
+{
+	closesocket(m_Socket);
+}
+
+//Methods
+//*******
+
+unique_ptr<TcpConnection> TcpConnection::Connect(const string& host, unsigned short port)
+{
+	InitializeSockets();
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* pAddresses = nullptr;
+	if(getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &pAddresses) != 0)
+		throw runtime_error("Failed to resolve " + host);
+
+	//Use the first address that accepts the connection
+	for(auto pAddress = pAddresses; pAddress; pAddress = pAddress->ai_next){
+		Socket sock = socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol);
+		if(sock == INVALID_SOCKET)
+			continue;
+
+		if(connect(sock, pAddress->ai_addr, static_cast<int>(pAddress->ai_addrlen)) == 0){
+			freeaddrinfo(pAddresses);
+			return unique_ptr<TcpConnection>(new TcpConnection(sock));
+		}
+		closesocket(sock);
+	}
+
+	freeaddrinfo(pAddresses);
+	throw runtime_error("Failed to connect to " + host + ":" + to_string(port));
+}
+
+bool TcpConnection::ReadLine(string& line)
+{
+	size_t iLineEnd;
+	while((iLineEnd = m_Received.find('\n')) == string::npos){
+		if(m_Received.size() > s_MaxLineLength)
+			return false;
+
+		char buffer[s_ReceiveChunkSize];
+		ssize_t nrOfBytes = recv(m_Socket, buffer, sizeof(buffer), 0);
+		if(nrOfBytes <= 0)
+			return false;
+		m_Received.append(buffer, nrOfBytes);
+	}
+
+	line = m_Received.substr(0, iLineEnd);
+	m_Received.erase(0, iLineEnd + 1);
+	if(!line.empty() && line.back() == '\r')
+		line.pop_back();
+	return true;
+}
+
+bool TcpConnection::ReadBytes(char* pData, size_t size)
+{
+	//Bytes that arrived along with the last line come first
+	size_t nrOfBuffered = min(size, m_Received.size());
+	m_Received.copy(pData, nrOfBuffered);
+	m_Received.erase(0, nrOfBuffered);
+
+	for(size_t received = nrOfBuffered; received < size; ){
+		ssize_t nrOfBytes = recv(m_Socket, pData + received, static_cast<int>(min(size - received, s_ReceiveChunkSize)), 0);
+		if(nrOfBytes <= 0)
+			return false;
+		received += nrOfBytes;
+	}
+	return true;
+}
+
+bool TcpConnection::Write(const string& data)
+{
+	return Write(data.data(), data.size());
+}
+
+bool TcpConnection::Write(const char* pData, size_t size)
+{
+	for(size_t sent = 0; sent < size; ){
+		ssize_t nrOfBytes = send(m_Socket, pData + sent, static_cast<int>(min(size - sent, s_ReceiveChunkSize)), 0);
+		if(nrOfBytes <= 0)
+			return false;
+		sent += nrOfBytes;
+	}
+	return true;
+}
+
+void TcpConnection::SetReadTimeout(unsigned int milliseconds)
+{
+#ifdef _WIN32
+	DWORD timeout = milliseconds;
+#else
+	timeval timeout = { static_cast<long>(milliseconds / 1000), static_cast<long>(milliseconds % 1000) * 1000 };
+#endif
+	setsockopt(m_Socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+void TcpConnection::EnableKeepAlive(void)
+{
+	int keepAlive = 1;
+	setsockopt(m_Socket, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<const char*>(&keepAlive), sizeof(keepAlive));
+
+	//The default waits two hours before the first probe
+#ifdef TCP_KEEPIDLE
+	setsockopt(m_Socket, IPPROTO_TCP, TCP_KEEPIDLE, reinterpret_cast<const char*>(&s_KeepAliveIdleSeconds), sizeof(s_KeepAliveIdleSeconds));
+	setsockopt(m_Socket, IPPROTO_TCP, TCP_KEEPINTVL, reinterpret_cast<const char*>(&s_KeepAliveIntervalSeconds), sizeof(s_KeepAliveIntervalSeconds));
+	setsockopt(m_Socket, IPPROTO_TCP, TCP_KEEPCNT, reinterpret_cast<const char*>(&s_KeepAliveProbeCount), sizeof(s_KeepAliveProbeCount));
+#endif
+}
+
+unique_ptr<TcpConnection> TcpListener::Accept(unsigned int timeoutMilliseconds)
+{
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(m_Socket, &readSet);
+	timeval timeout = { static_cast<long>(timeoutMilliseconds / 1000), static_cast<long>(timeoutMilliseconds % 1000) * 1000 };
+
+	if(select(static_cast<int>(m_Socket) + 1, &readSet, nullptr, nullptr, &timeout) <= 0)
+		return nullptr;
+
+	TcpConnection::Socket connection = accept(m_Socket, nullptr, nullptr);
+	if(connection == INVALID_SOCKET)
+		return nullptr;
+
+	return unique_ptr<TcpConnection>(new TcpConnection(connection));
+}
@@ -0,0 +1,79 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+// Blocking TCP connection, exchanging text lines and raw bytes.
+class TcpConnection final
+{
+public:
+#ifdef _WIN32
+	typedef uintptr_t Socket;
+#else
+	typedef int Socket;
+#endif
+
+	TcpConnection(Socket socket);
+	~TcpConnection(void);
+
+	// * Connects to host:port, throws on failure.
+	static std::unique_ptr<TcpConnection> Connect(const std::string& host, unsigned short port);
+
+	// * Reads up to the next newline, which isn't stored in line. Returns false when the connection is lost or the line is unreasonably long.
+	bool ReadLine(std::string& line);
+	bool ReadBytes(char* pData, size_t size);
+
+	bool Write(const std::string& data);
+	bool Write(const char* pData, size_t size);
+
+	// * Makes reads fail after waiting milliseconds for data (0 => wait forever), as if the connection was lost.
+	void SetReadTimeout(unsigned int milliseconds);
+
+	// * Probes an idle connection, so that a peer that vanished without closing it is noticed within minutes.
+	void EnableKeepAlive(void);
+
+private:
+	Socket m_Socket;
+	std::string m_Received; //Bytes received past the last line
+
+	//Disabling copy constructor & assignment operator
+	TcpConnection(const TcpConnection& src);
+	TcpConnection& operator=(const TcpConnection& src);
+};
+
+// Accepts TCP connections on a port of a single interface.
+class TcpListener final
+{
+public:
+	// * address: host name or address of the interface to listen on. Throws if the port can't be bound.
+	TcpListener(const std::string& address, unsigned short port);
+	~TcpListener(void);
+
+	// * Waits at most timeoutMilliseconds for a connection, returns nullptr if none arrived.
+	std::unique_ptr<TcpConnection> Accept(unsigned int timeoutMilliseconds);
+
+private:
+	TcpConnection::Socket m_Socket;
+
+	//Disabling copy constructor & assignment operator
+	TcpListener(const TcpListener& src);
+	TcpListener& operator=(const TcpListener& src);
+};
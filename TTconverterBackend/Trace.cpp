@@ -0,0 +1,123 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Trace.h"
+#include "StringUtils.h"
+
+#include <iostream>
+#include <fstream>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+atomic<bool> Trace::s_IsEnabled(false);
+atomic<unsigned int> Trace::s_NrOfJobs(0);
+atomic<unsigned int> Trace::s_NrOfThreads(0);
+chrono::steady_clock::time_point Trace::s_Begin;
+vector<Trace::Event> Trace::s_Events;
+mutex Trace::s_Mutex;
+
+thread_local unsigned int Trace::s_CurrentJob = 0;
+thread_local unsigned int Trace::s_ThreadId = 0;
+
+//Constructor & Destructor
+//************************
+
+TraceJobScope::TraceJobScope(unsigned int jobId):m_Previous(Trace::s_CurrentJob)
+{
+	Trace::s_CurrentJob = jobId;
+}
+
+TraceJobScope::~TraceJobScope(void)
+{
+	Trace::s_CurrentJob = m_Previous;
+}
+
+//Methods
+//*******
+
+void Trace::Start(void)
+{
+	lock_guard<mutex> lock(s_Mutex);
+	s_Events.clear();
+	s_Begin = chrono::steady_clock::now();
+	s_IsEnabled = true;
+}
+
+void Trace::Save(const string& filename)
+{
+#ifdef _WIN32
+	unsigned long processId = GetCurrentProcessId();
+#else
+	unsigned long processId = getpid();
+#endif
+
+	lock_guard<mutex> lock(s_Mutex);
+
+	//Complete events ("X"), with the time stamps in microseconds
+	ofstream file(filename);
+	file.precision(15);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+	for(unsigned int i=0; i < s_Events.size(); ++i){
+		auto& ev = s_Events[i];
+		file << (i == 0 ? "\n" : ",\n") << "{\"name\": " << ToJson(ev.Name) << ", \"ph\": \"X\", \"ts\": " << ev.Begin << ", \"dur\": " << ev.Duration
+			<< ", \"pid\": " << processId << ", \"tid\": " << ev.ThreadId << ", \"args\": {\"job\": " << ev.JobId;
+		if(!ev.Detail.empty())
+			file << ", \"detail\": " << ToJson(ev.Detail);
+		file << "}}";
+	}
+	file << "\n]}\n";
+	s_Events.clear();
+
+	if(!file)
+		cout << "Unable to write " << filename << ".\n";
+}
+
+unsigned int Trace::CreateJob(void)
+{
+	return ++s_NrOfJobs;
+}
+
+unsigned int Trace::GetCurrentJob(void)
+{
+	return s_CurrentJob;
+}
+
+double Trace::GetTime(void)
+{
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - s_Begin).count();
+}
+
+void Trace::Record(const char* name, const string& detail, double begin)
+{
+	//Threads are numbered in the order in which they record their first zone
+	if(s_ThreadId == 0)
+		s_ThreadId = ++s_NrOfThreads;
+
+	Event ev = { name, detail, s_ThreadId, s_CurrentJob, begin, GetTime() - begin };
+
+	lock_guard<mutex> lock(s_Mutex);
+	if(s_IsEnabled)
+		s_Events.push_back(ev);
+}
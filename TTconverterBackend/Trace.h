@@ -0,0 +1,125 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+// Records timed zones of a conversion as trace events, written as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+// Every zone is tagged with its thread & job. While tracing is disabled a zone costs a single check of a flag.
+class Trace final
+{
+public:
+	// * Starts recording zones of all threads.
+	static void Start(void);
+	// * Writes the zones recorded since the last save and forgets them, recording continues.
+	// * Long running modes save after every round, so the recorded zones don't pile up.
+	static void Save(const std::string& filename);
+
+	static bool IsEnabled(void)
+	{
+		return s_IsEnabled.load(std::memory_order_relaxed);
+	}
+
+	// * New id for a job, zones are tagged with the job of the thread that records them.
+	static unsigned int CreateJob(void);
+	//Job of the calling thread (0 => none)
+	static unsigned int GetCurrentJob(void);
+
+private:
+	friend class TraceZone;
+	friend class TraceJobScope;
+
+	struct Event{
+		const char* Name;
+		std::string Detail;
+		unsigned int ThreadId;
+		unsigned int JobId;
+		double Begin; //Microseconds since the start of the trace
+		double Duration;
+	};
+
+	static std::atomic<bool> s_IsEnabled;
+	static std::atomic<unsigned int> s_NrOfJobs;
+	static std::atomic<unsigned int> s_NrOfThreads;
+	static std::chrono::steady_clock::time_point s_Begin;
+	static std::vector<Event> s_Events;
+	static std::mutex s_Mutex;
+
+	static thread_local unsigned int s_CurrentJob;
+	static thread_local unsigned int s_ThreadId;
+
+	static double GetTime(void);
+	static void Record(const char* name, const std::string& detail, double begin);
+
+	//Disabling default constructor, copy constructor & assignment operator
+	Trace(void);
+	Trace(const Trace& src);
+	Trace& operator=(const Trace& src);
+};
+
+// Records the time from construction until the end of the scope (or Stop) as a zone of the calling thread
+class TraceZone final
+{
+public:
+	// * name: static string naming the zone, detail: shown with the zone (e.g. the input of a job)
+	TraceZone(const char* name):m_Name(name), m_Begin(Trace::IsEnabled() && name ? Trace::GetTime() : -1)
+	{}
+
+	TraceZone(const char* name, const std::string& detail):m_Name(name), m_Detail(detail), m_Begin(Trace::IsEnabled() && name ? Trace::GetTime() : -1)
+	{}
+
+	~TraceZone(void)
+	{
+		Stop();
+	}
+
+	void Stop(void)
+	{
+		if(m_Begin >= 0)
+			Trace::Record(m_Name, m_Detail, m_Begin);
+		m_Begin = -1;
+	}
+
+private:
+	const char* m_Name;
+	std::string m_Detail;
+	double m_Begin; //Negative => not recorded
+
+	//Disabling copy constructor & assignment operator
+	TraceZone(const TraceZone& src);
+	TraceZone& operator=(const TraceZone& src);
+};
+
+// Tags the zones of the calling thread with a job for the lifetime of the scope
+class TraceJobScope final
+{
+public:
+	TraceJobScope(unsigned int jobId);
+	~TraceJobScope(void);
+
+private:
+	unsigned int m_Previous;
+
+	//Disabling copy constructor & assignment operator
+	TraceJobScope(const TraceJobScope& src);
+	TraceJobScope& operator=(const TraceJobScope& src);
+};
@@ -0,0 +1,190 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Triangulator.h"
+#include "Parallel.h"
+#include "CancellationToken.h"
+
+#include <cmath>
+
+using namespace std;
+
+//Number of polygons handled per task
+static const unsigned int s_PolygonGrainSize = 4096;
+
+struct Point2{
+	double x, y;
+};
+
+//Z component of the cross product of (b-a) and (c-b)
+static double Cross(const Point2& a, const Point2& b, const Point2& c)
+{
+	return (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+}
+
+//Check if p lies inside (or on the edge of) triangle abc with the given winding sign
+static bool IsInsideTriangle(const Point2& p, const Point2& a, const Point2& b, const Point2& c, double sign)
+{
+	return sign * Cross(a, b, p) >= 0 && sign * Cross(b, c, p) >= 0 && sign * Cross(c, a, p) >= 0;
+}
+
+//Triangulate a single polygon, writing 3*(nrOfCorners-2) polygon-vertex indices to pOut
+//points & remaining are scratch buffers, reused between polygons to avoid allocations
+static void TriangulatePolygon(const FbxVector4* pControlPoints, const int* pPolygonVertices, unsigned int firstCorner, unsigned int nrOfCorners, 
+							   unsigned int* pOut, vector<Point2>& points, vector<unsigned int>& remaining)
+{
+	//Triangles need no work
+	if(nrOfCorners == 3){
+		pOut[0] = firstCorner;
+		pOut[1] = firstCorner + 1;
+		pOut[2] = firstCorner + 2;
+		return;
+	}
+
+	//Compute polygon normal (Newell's method), robust for non-planar and concave polygons
+	double normal[3] = {0, 0, 0};
+	for(unsigned int i=0; i < nrOfCorners; ++i){
+		const double* cur = pControlPoints[pPolygonVertices[firstCorner + i]].mData;
+		const double* next = pControlPoints[pPolygonVertices[firstCorner + (i+1) % nrOfCorners]].mData;
+		normal[0] += (cur[1] - next[1]) * (cur[2] + next[2]);
+		normal[1] += (cur[2] - next[2]) * (cur[0] + next[0]);
+		normal[2] += (cur[0] - next[0]) * (cur[1] + next[1]);
+	}
+
+	//Project on the plane of the two axes that are most perpendicular to the normal
+	unsigned int dropAxis = 2;
+	if(fabs(normal[0]) > fabs(normal[1]) && fabs(normal[0]) > fabs(normal[2]))
+		dropAxis = 0;
+	else if(fabs(normal[1]) > fabs(normal[2]))
+		dropAxis = 1;
+
+	const unsigned int axisU = (dropAxis + 1) % 3, axisV = (dropAxis + 2) % 3;
+	const double sign = normal[dropAxis] >= 0 ? 1.0 : -1.0;
+
+	points.resize(nrOfCorners);
+	bool isConvex = true;
+	for(unsigned int i=0; i < nrOfCorners; ++i){
+		const double* pos = pControlPoints[pPolygonVertices[firstCorner + i]].mData;
+		points[i].x = pos[axisU];
+		points[i].y = pos[axisV];
+	}
+
+	for(unsigned int i=0; i < nrOfCorners && isConvex; ++i)
+		isConvex = sign * Cross(points[i], points[(i+1) % nrOfCorners], points[(i+2) % nrOfCorners]) >= 0;
+
+	//Convex polygons are fanned out from their first corner
+	if(isConvex){
+		for(unsigned int i=1; i+1 < nrOfCorners; ++i, pOut += 3){
+			pOut[0] = firstCorner;
+			pOut[1] = firstCorner + i;
+			pOut[2] = firstCorner + i + 1;
+		}
+		return;
+	}
+
+	//Concave polygons: clip ears until a triangle remains
+	remaining.resize(nrOfCorners);
+	for(unsigned int i=0; i < nrOfCorners; ++i)
+		remaining[i] = i;
+
+	while(remaining.size() > 3){
+		//Clipping every ear is quadratic in the nr of corners, polygons with a huge nr of them can take very long
+		CancellationToken::Check();
+
+		const unsigned int nrOfRemaining = remaining.size();
+		bool foundEar = false;
+
+		for(unsigned int i=0; i < nrOfRemaining && !foundEar; ++i){
+			unsigned int prev = remaining[(i + nrOfRemaining - 1) % nrOfRemaining];
+			unsigned int cur = remaining[i];
+			unsigned int next = remaining[(i+1) % nrOfRemaining];
+
+			//Reflex and degenerate corners can't be ears
+			if(sign * Cross(points[prev], points[cur], points[next]) <= 0)
+				continue;
+
+			//No other corner may lie inside the ear
+			bool isEar = true;
+			for(unsigned int j=0; j < nrOfRemaining && isEar; ++j){
+				unsigned int other = remaining[j];
+				if(other != prev && other != cur && other != next)
+					isEar = !IsInsideTriangle(points[other], points[prev], points[cur], points[next], sign);
+			}
+
+			if(!isEar)
+				continue;
+
+			pOut[0] = firstCorner + prev;
+			pOut[1] = firstCorner + cur;
+			pOut[2] = firstCorner + next;
+			pOut += 3;
+
+			remaining.erase(remaining.begin() + i);
+			foundEar = true;
+		}
+
+		//Self-intersecting or degenerate polygon: fan out whatever is left
+		if(!foundEar)
+			break;
+	}
+
+	for(unsigned int i=1; i+1 < remaining.size(); ++i, pOut += 3){
+		pOut[0] = firstCorner + remaining[0];
+		pOut[1] = firstCorner + remaining[i];
+		pOut[2] = firstCorner + remaining[i+1];
+	}
+}
+
+void Triangulate(FbxMesh* pMesh, Triangulation& triangulation)
+{
+	const unsigned int nrOfPolygons = pMesh->GetPolygonCount();
+	const FbxVector4* pControlPoints = pMesh->GetControlPoints();
+	const int* pPolygonVertices = pMesh->GetPolygonVertices();
+
+	//A polygon with n corners always results in n-2 triangles, so every polygon's output offset is known up front.
+	//The parallel pass below only reads these arrays, the fbx sdk isn't called from several threads.
+	ArenaVector<unsigned int> firstTriangle(nrOfPolygons + 1, 0);
+	ArenaVector<unsigned int> firstCorner(nrOfPolygons, 0);
+	for(unsigned int iPoly=0; iPoly < nrOfPolygons; ++iPoly){
+		int polySize = pMesh->GetPolygonSize(iPoly);
+		firstTriangle[iPoly+1] = firstTriangle[iPoly] + (polySize > 2 ? polySize - 2 : 0);
+		firstCorner[iPoly] = pMesh->GetPolygonVertexIndex(iPoly);
+	}
+
+	const unsigned int nrOfTriangles = firstTriangle.back();
+	triangulation.Corners.resize(3 * nrOfTriangles);
+	triangulation.Polygons.resize(nrOfTriangles);
+
+	ParallelForRange(0, nrOfPolygons, s_PolygonGrainSize, [&](unsigned int polyBegin, unsigned int polyEnd){
+		CancellationToken::Check();
+
+		vector<Point2> points;
+		vector<unsigned int> remaining;
+
+		for(unsigned int iPoly = polyBegin; iPoly < polyEnd; ++iPoly){
+			const unsigned int nrOfTriangles = firstTriangle[iPoly+1] - firstTriangle[iPoly];
+			if(nrOfTriangles == 0)
+				continue;
+
+			for(unsigned int iTri = firstTriangle[iPoly]; iTri < firstTriangle[iPoly+1]; ++iTri)
+				triangulation.Polygons[iTri] = iPoly;
+
+			TriangulatePolygon(pControlPoints, pPolygonVertices, firstCorner[iPoly], nrOfTriangles + 2, 
+							   &triangulation.Corners[3 * firstTriangle[iPoly]], points, remaining);
+		}
+	});
+}
@@ -0,0 +1,33 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include <fbxsdk.h>
+#include "ConversionArena.h"
+
+//Triangles of an FbxMesh, expressed as polygon-vertex indices (offsets into FbxMesh::GetPolygonVertices)
+struct Triangulation{
+	ArenaVector<unsigned int> Corners;	//3 polygon-vertex indices per triangle
+	ArenaVector<unsigned int> Polygons;	//Source polygon per triangle
+};
+
+// * Splits every polygon of the mesh into triangles, using a fan for convex polygons and ear clipping for concave ones.
+// * Works on the polygon sizes directly, so the scene doesn't have to be triangulated by the FBX SDK first.
+// * Polygons are processed in parallel ranges, polygons with less than 3 vertices are skipped.
+void Triangulate(FbxMesh* pMesh, Triangulation& triangulation);
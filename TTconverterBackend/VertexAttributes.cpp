@@ -17,72 +17,149 @@
 
 #include "VertexAttributes.h"
 #include "FileOutput.h"
+#include "Parallel.h"
+#include "CancellationToken.h"
 			
-#include <map>
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
 
 using namespace std;
 
+//Number of triangles handled per task by the fused extraction pass
+static const unsigned int s_TriangleGrainSize = 16384;
+
 //Constructor & Destructor
-Mesh::Mesh(FbxMesh* _pMesh):pMesh(_pMesh){}
+Mesh::Mesh(FbxMesh* _pMesh):Name(_pMesh->GetName()), pMesh(_pMesh){}
 Mesh::Mesh(void):pMesh(nullptr){}
 
-//Get mesh node name
-string Mesh::GetName(void)
+//Check if this mesh is deformed (deformed meshes get blend information for every control point)
+bool Mesh::ContainsAnimationData(void) const
 {
-	if(!pMesh)
-		throw exception("Failure to extract data: Mesh object is uninitialized");
+	return !BlendInformation.data.empty();
+}
 
-	return string(pMesh->GetName() );
+//Drop the last influences of vertices that are linked to more than maxInfluences bones
+void Mesh::LimitBoneInfluences(unsigned int maxInfluences)
+{
+	for(auto& elem : BlendInformation.data)
+		while(elem.BlendIndices.size() > maxInfluences)
+		{
+			elem.BlendIndices.pop_back();
+			elem.BlendWeights.pop_back();
+		}
 }
 
-//Check if this mesh is deformed
-bool Mesh::ContainsAnimationData(void)
+//Sample the node transform, and the bone transforms at the given points in time
+void Mesh::SampleTransforms(const vector<double>& times)
 {
 	if(!pMesh)
-		throw exception("Failure to extract data: Mesh object is uninitialized");
+		throw runtime_error("Failure to sample transforms: Mesh object is uninitialized");
+
+	GlobalTransform = pMesh->GetNode()->EvaluateGlobalTransform();
+
+	for(auto time : times){
+		CancellationToken::Check();
 
-	return pMesh->GetDeformerCount() > 0;
+		FbxTime fbxTime;
+		fbxTime.SetFrame(FbxLongLong(time) );
+
+		auto& transforms = BoneTransformsAtTime[time];
+		transforms.clear();
+		transforms.reserve(Skeleton.size());
+		for(auto& bone : Skeleton)
+			transforms.push_back( bone.pFbxNode->EvaluateGlobalTransform(fbxTime) );
+	}
 }
 
-//Sample bone transforms at a specified point in time
-vector<FbxAMatrix> Mesh::GetBoneTransforms(double time) const
+//Get bone transforms at a point in time sampled by SampleTransforms
+ArenaVector<FbxAMatrix> Mesh::GetBoneTransforms(double time) const
 {
-	vector<FbxAMatrix> out;
-	FbxTime fbxTime;
-	fbxTime.SetFrame(FbxLongLong(time) );
-	
-	for(auto& bone : Skeleton)
-		out.push_back( bone.pFbxNode->EvaluateGlobalTransform(fbxTime) );
+	auto it = BoneTransformsAtTime.find(time);
+	if(it != BoneTransformsAtTime.end())
+		return it->second;
+
+	if(!Skeleton.empty())
+		throw runtime_error("Failure to get bone transforms: time stamp wasn't sampled");
 
-	return out;
+	return ArenaVector<FbxAMatrix>();
 }
 
 //Extract vertex attributes from the fbx sdk
 void Mesh::ExtractData(void)
 {		
 	if(!pMesh)
-		throw exception("Failure to extract data: Mesh object is uninitialized");
+		throw runtime_error("Failure to extract data: Mesh object is uninitialized");
 	
-	cout << "Extracting vertex attributes... ";
-	//Copy vertex attribute arrays into vectors of our own
+	//Split polygons into triangles
+	Triangulation triangulation;
+	Triangulate(pMesh, triangulation);
+
+	//Copy vertex attribute arrays into vectors of our own, their indices are resolved in a single pass below
 	unsigned int layerCount = pMesh->GetLayerCount();
-	unsigned int triCount = pMesh->GetPolygonCount();
+	unsigned int triCount = triangulation.Polygons.size();
+	unsigned int nrOfCorners = triangulation.Corners.size();
+	vector<AttributeSource> sources;
+
+	//Locked index arrays are released on every exit, failed and cancelled extractions included
+	struct SourceLocks{
+		vector<AttributeSource>& Sources;
+
+		~SourceLocks(void)
+		{
+			for(auto& source : Sources)
+				if(source.pLockedIndices)
+					source.pIndexArray->Release(&source.pLockedIndices);
+		}
+	} sourceLocks = { sources };
+
 	for (unsigned int layer=0; layer<layerCount; ++layer){
 		auto pLayer = pMesh->GetLayer(layer);			
 	
-		TexCoords.ExtractData(	pMesh, pLayer->GetUVs() );
-		Normals.ExtractData(	pMesh, pLayer->GetNormals() );
-		Tangents.ExtractData(	pMesh, pLayer->GetTangents() );
-		Binormals.ExtractData(	pMesh, pLayer->GetBinormals() );
-		Colors.ExtractData(		pMesh, pLayer->GetVertexColors() );
+		TexCoords.PrepareExtraction(	pLayer->GetUVs(),			nrOfCorners, sources );
+		Normals.PrepareExtraction(		pLayer->GetNormals(),		nrOfCorners, sources );
+		Tangents.PrepareExtraction(		pLayer->GetTangents(),		nrOfCorners, sources );
+		Binormals.PrepareExtraction(	pLayer->GetBinormals(),		nrOfCorners, sources );
+		Colors.PrepareExtraction(		pLayer->GetVertexColors(),	nrOfCorners, sources );
 	}
+
+	//Get names of the materials applied to this mesh node
+	auto pNode = pMesh->GetNode();
+	unsigned int nrOfMaterials = pNode ? pNode->GetMaterialCount() : 0;
+	for(unsigned int i=0; i < nrOfMaterials; ++i)
+		MaterialNames.push_back( pNode->GetMaterial(i)->GetName() );
+
+	//Get material index per triangle (meshes without material layer use a single unnamed material)
+	TriangleMaterials.assign(triCount, 0);
+	auto pMaterialLayer = layerCount > 0 ? pMesh->GetLayer(0)->GetMaterials() : nullptr;
+	if(pMaterialLayer){
+		//Direct reference mode maps the element to the material with the same index, otherwise the index array holds the material index
+		auto& idxArr = pMaterialLayer->GetIndexArray();
+		bool isDirect = pMaterialLayer->GetReferenceMode() == FbxLayerElement::eDirect;
+
+		switch(pMaterialLayer->GetMappingMode()){
+			case FbxLayerElement::eAllSame:
+				TriangleMaterials.assign(triCount, !isDirect && idxArr.GetCount() > 0 ? idxArr.GetAt(0) : 0);
+				break;
+			case FbxLayerElement::eByPolygon:
+				for(unsigned int iTri=0; iTri < triCount; ++iTri){
+					unsigned int iPolygon = triangulation.Polygons[iTri];
+					TriangleMaterials[iTri] = isDirect ? iPolygon : idxArr.GetAt(iPolygon);
+				}
+				break;
+			default:
+				throw runtime_error("Invalid material mapping mode");
+		}
+	}
+
+	//Blend information per control point (control points that aren't linked to any bone keep empty blend info)
+	ArenaVector<BlendInfo> blendInfoPerControlPoint;
 	
-	map<unsigned int, BlendInfo> blendInfoPerVertexIndex;
-	
-	cout << "Done.\nBuilding skeleton... ";
 	//Get skeleton data
 	unsigned int nrOfDeformers = pMesh->GetDeformerCount();
+	if(nrOfDeformers > 0)
+		blendInfoPerControlPoint.resize(pMesh->GetControlPointsCount());
+
 	for(unsigned int iDeformer=0; iDeformer < nrOfDeformers; ++iDeformer){
 		auto pSkin = reinterpret_cast<FbxSkin*>( pMesh->GetDeformer(iDeformer, FbxDeformer::eSkin) );
 
@@ -108,42 +185,122 @@ void Mesh::ExtractData(void)
 				
 			//Get blend index & weight per vertex
 			unsigned int nrOfIndices = pCluster->GetControlPointIndicesCount();
+			const int* pPtIndices = pCluster->GetControlPointIndices();
+			const double* pWeights = pCluster->GetControlPointWeights();
 			for(unsigned int i=0; i<nrOfIndices; ++i){
-				unsigned int ptIndex = pCluster->GetControlPointIndices()[i];
-				double weight = pCluster->GetControlPointWeights()[i];
-
-				auto it = blendInfoPerVertexIndex.find(ptIndex);
-
-				if(it == blendInfoPerVertexIndex.end())
-					it = blendInfoPerVertexIndex.insert(make_pair(ptIndex, BlendInfo() ) ).first;
-				
-				it->second.BlendIndices.push_back(iCluster);
-				it->second.BlendWeights.push_back(weight);
+				auto& blendInfo = blendInfoPerControlPoint[pPtIndices[i]];
+				blendInfo.BlendIndices.push_back(Skeleton.size() - 1);
+				blendInfo.BlendWeights.push_back(static_cast<float>(pWeights[i]));
 			}
 		}
 	}
-	//Allocate necessary data
-	Positions.data.reserve(triCount*3);
-	if(nrOfDeformers > 0)
-		BlendInformation.data.reserve(triCount*3);
+
+	//Positions and blend information stay in control point space, only their indices are expanded per triangle corner
+	const FbxVector4* pControlPoints = pMesh->GetControlPoints();
+	Positions.data.resize(pMesh->GetControlPointsCount());
+	for(unsigned int i=0; i < Positions.data.size(); ++i)
+		ConvertAttribute(pControlPoints[i], Positions.data[i]);
+	Positions.indices.resize(nrOfCorners);
+
+	if(nrOfDeformers > 0){
+		BlendInformation.data = move(blendInfoPerControlPoint);
+		BlendInformation.indices.resize(nrOfCorners);
+	}
 	
-	//Get vertex positions and link them up to bones if necessary
-	for (unsigned int iTri=0; iTri<triCount; ++iTri){
-		for (unsigned int iVert=0; iVert<3; ++iVert){
-			int cpIndex = pMesh->GetPolygonVertex(iTri,iVert);
-			Positions.data.push_back( pMesh->GetControlPointAt(cpIndex) );
+	//Fused pass over all triangle corners: resolve the index of every attribute
+	const int* pPolygonVertices = pMesh->GetPolygonVertices();
+	ParallelForRange(0, triCount, s_TriangleGrainSize, [&](unsigned int triBegin, unsigned int triEnd){
+		CancellationToken::Check();
+		unsigned int elements[3];
+
+		for(unsigned int i = 3*triBegin; i < 3*triEnd; ++i){
+			elements[AttributeSource::eControlPoint] = pPolygonVertices[triangulation.Corners[i]];
+			elements[AttributeSource::ePolygonVertex] = triangulation.Corners[i];
+			elements[AttributeSource::ePolygon] = triangulation.Polygons[i/3];
+
+			Positions.indices[i] = elements[AttributeSource::eControlPoint];
 			
-			if(nrOfDeformers > 0){
-				auto& blendInfo = blendInfoPerVertexIndex.find(cpIndex)->second;
-				BlendInformation.data.push_back(move(blendInfo));
+			if(!BlendInformation.indices.empty())
+				BlendInformation.indices[i] = elements[AttributeSource::eControlPoint];
+
+			for(auto& source : sources){
+				unsigned int element = elements[source.Element];
+				source.pIndices[i] = source.pLockedIndices ? source.pLockedIndices[element] : element;
 			}
 		}
+	});
+}
+
+//Transform positions and directions to world space using the node's global transform (call after Optimize & SampleTransforms)
+void Mesh::BakeTransform(void)
+{
+	const FbxAMatrix& transform = GlobalTransform;
+
+	//Directions are transformed by the inverse transpose of the rotation & scale part
+	FbxAMatrix dirTransform = transform;
+	dirTransform.SetT(FbxVector4(0,0,0,0));
+	dirTransform = dirTransform.Inverse().Transpose();
+
+	for(auto& elem : Positions.data)
+		ConvertAttribute(transform.MultT(FbxVector4(elem.x, elem.y, elem.z, 1)), elem);
+
+	for(auto pDirections : { &Normals.data, &Tangents.data, &Binormals.data })
+		for(auto& elem : *pDirections){
+			FbxVector4 dir = dirTransform.MultT(FbxVector4(elem.x, elem.y, elem.z, 0));
+			dir.Normalize();
+			ConvertAttribute(dir, elem);
+		}
+
+	//Mirroring transforms flip the winding order of the triangles
+	if(transform.Determinant() >= 0)
+		return;
+
+	for(auto pIndices : { &Positions.indices, &TexCoords.indices, &Normals.indices, &Tangents.indices, &Binormals.indices, &Colors.indices })
+		for(unsigned int i=0; i + 2 < pIndices->size(); i += 3)
+			swap((*pIndices)[i+1], (*pIndices)[i+2]);
+}
+
+//Concatenate the optimized vertex attributes and triangles of another mesh with the same vertex format
+void Mesh::Append(const Mesh& other)
+{
+	Positions.Append(other.Positions);
+	TexCoords.Append(other.TexCoords);
+	Normals.Append(other.Normals);
+	Tangents.Append(other.Tangents);
+	Binormals.Append(other.Binormals);
+	Colors.Append(other.Colors);
+
+	//Materials are shared by name, so that equal materials end up in a single draw range (the last entry is used for invalid indices)
+	vector<unsigned int> materialRemap;
+	for(unsigned int i=0; i <= other.MaterialNames.size(); ++i){
+		string name = i < other.MaterialNames.size() ? other.MaterialNames[i] : "";
+		auto it = find(MaterialNames.begin(), MaterialNames.end(), name);
+
+		if(it == MaterialNames.end()){
+			MaterialNames.push_back(name);
+			it = MaterialNames.end() - 1;
+		}
+
+		materialRemap.push_back(it - MaterialNames.begin());
+	}
+
+	const unsigned int nrOfMaterials = other.MaterialNames.size();
+	for(auto iMaterial : other.TriangleMaterials)
+		TriangleMaterials.push_back(materialRemap[min(iMaterial, nrOfMaterials)]);
+}
+
+void Mesh::DetachFromScene(void)
+{
+	pMesh = nullptr;
+	for(auto& bone : Skeleton){
+		bone.pFbxNode = nullptr;
+		bone.pCluster = nullptr;
 	}
 }
 
 void Mesh::Optimize(void)
 {
-	Positions.Optimize();
+	//Positions are stored per control point and don't need deduplication, control points often share their blend information
 	TexCoords.Optimize();
 	Normals.Optimize();
 	Tangents.Optimize();
@@ -19,146 +19,195 @@
 
 #include <fbxsdk.h>
 #include <vector>
+#include <unordered_map>
+#include <map>
+#include <string>
+#include <stdexcept>
+#include "Triangulator.h"
+#include "FloatTypes.h"
+#include "ConversionArena.h"
+#include "Deduplicate.h"
 
 struct BlendInfo{
-	std::vector<unsigned int>	BlendIndices;
-	std::vector<double>			BlendWeights;
+	ArenaVector<unsigned int>	BlendIndices;
+	ArenaVector<float>			BlendWeights;
 
-	bool operator==(const BlendInfo& other)
+	bool operator==(const BlendInfo& other) const
 	{
 		return BlendIndices == other.BlendIndices && BlendWeights == other.BlendWeights;
 	}
+};
 
-	BlendInfo& operator=(BlendInfo&& src)
-	{
-		BlendIndices = std::move(BlendIndices);
-		BlendWeights = std::move(BlendWeights);
-		return *this;
-	}
-
-	BlendInfo& operator=(const BlendInfo& src)
-	{
-		BlendIndices = BlendIndices;
-		BlendWeights = BlendWeights;
-		return *this;
-	}
-
-	BlendInfo(const BlendInfo& src)
+template<>
+//Blend information isn't plain-old-data, its arrays are hashed instead
+struct BitwiseHash<BlendInfo>{
+	size_t operator()(const BlendInfo& val) const
 	{
-		*this = src;
+		size_t hash = 2166136261u;
+		for(auto index : val.BlendIndices)
+			hash = (hash ^ BitwiseHash<unsigned int>()(index)) * 16777619u;
+		for(auto weight : val.BlendWeights)
+			hash = (hash ^ BitwiseHash<float>()(weight)) * 16777619u;
+		return hash;
 	}
+};
 
-	BlendInfo()
-	{
-	}
+//Layer element of a single vertex attribute, resolved by the fused extraction pass of Mesh::ExtractData
+struct AttributeSource{
+	//Element the layer's data is mapped to
+	enum ElementType{
+		eControlPoint,
+		ePolygonVertex,
+		ePolygon
+	} Element;
 
+	FbxLayerElementArrayTemplate<int>* pIndexArray; //nullptr for direct reference mode
+	int* pLockedIndices;
+	unsigned int* pIndices; //Output index per triangle corner
 };
 
 template<typename T>
 //Generic class to store vertex attributes (texcoords, normals...)
 struct VertexAttribute{
-	std::vector<T> data;
-	std::vector<unsigned int> indices;
+	ArenaVector<T> data;
+	ArenaVector<unsigned int> indices;
 
 	const T& GetRefAt(unsigned int vertexIndex)
 	{
 		return data.at(indices.at(vertexIndex));
 	}
 
-	void ExtractData(FbxMesh* pMesh, FbxLayerElementTemplate<T>* pLayerElement)
+	template<typename FbxType>
+	//Convert the attribute's data array to compact floats in one go and register its layer element with the fused extraction pass of Mesh::ExtractData
+	void PrepareExtraction(FbxLayerElementTemplate<FbxType>* pLayerElement, unsigned int nrOfCorners, std::vector<AttributeSource>& sources)
 	{
 		if(!pLayerElement) //Input validation
 			return;
-		
-		//Get internal data array
-		const auto dataArr = pLayerElement->GetDirectArray();
-		const unsigned int nrOfEntries = dataArr.GetCount();
+
+		//Only the first layer containing this attribute is used
+		if(!data.empty())
+			return;
 		
 		//Copy data array to our vector
-		data.reserve(nrOfEntries); //Avoid re-allocating
-		for(unsigned int i=0; i < nrOfEntries; ++i)
-			data.push_back(dataArr.GetAt(i));
+		auto& dataArr = pLayerElement->GetDirectArray();
+		FbxType* pData = dataArr.GetLocked(FbxLayerElementArray::eReadLock);
+		data.resize(dataArr.GetCount());
+		for(unsigned int i=0; i < data.size(); ++i)
+			ConvertAttribute(pData[i], data[i]);
+		dataArr.Release(&pData);
+
+		AttributeSource source;
+		switch(pLayerElement->GetMappingMode()){
+			case FbxLayerElement::eByControlPoint:
+				source.Element = AttributeSource::eControlPoint;
+				break;
+			case FbxLayerElement::eByPolygonVertex: 
+				source.Element = AttributeSource::ePolygonVertex;
+				break;
+			case FbxLayerElement::eByPolygon: 
+				source.Element = AttributeSource::ePolygon;
+				break;
+			default:
+				throw std::runtime_error("Invalid mapping mode");
+		}
 
 		//Check if the fbx sdk uses an internal index array
-		const auto referenceMode = pLayerElement->GetReferenceMode();
-		if(referenceMode == FbxLayerElement::eDirect)
-			return;
-		
-		const auto mappingMode = pLayerElement->GetMappingMode();
-		const unsigned int nrOfTriangles = pMesh->GetPolygonCount();
-		
-		auto& idxArr = pLayerElement->GetIndexArray();
-		
-		//Loop through all vertices and get the index associated with them
-		for(unsigned int iTri=0; iTri < nrOfTriangles; ++iTri){
-			for(unsigned int iVert=0; iVert<3; ++iVert){
-
-				switch(mappingMode){
-					case FbxLayerElement::eByControlPoint:
-						switch(referenceMode)
-						{
-							case FbxLayerElement::eIndexToDirect:
-								indices.push_back(idxArr[pMesh->GetPolygonVertex(iTri,iVert)]);
-								break;
-							default:
-								throw std::exception("Invalid reference mode");
-						}
-						break;
-					case FbxLayerElement::eByPolygonVertex: 
-						switch(referenceMode)
-						{
-							case FbxLayerElement::eIndexToDirect:
-								indices.push_back(idxArr[(3*iTri + iVert)]);
-								break;
-							default:
-								throw std::exception("Invalid reference mode");
-						}
-						break;
-					default:
-						throw std::exception("Invalid mapping mode");
-				}
-			}
+		switch(pLayerElement->GetReferenceMode()){
+			case FbxLayerElement::eDirect:
+				source.pIndexArray = nullptr;
+				source.pLockedIndices = nullptr;
+				break;
+			case FbxLayerElement::eIndexToDirect:
+				source.pIndexArray = &pLayerElement->GetIndexArray();
+				source.pLockedIndices = nullptr;
+				break;
+			default:
+				throw std::runtime_error("Invalid reference mode");
 		}
+
+		//Index array is filled in per triangle corner by the fused pass
+		indices.resize(nrOfCorners);
+		source.pIndices = indices.data();
+		sources.push_back(source);
+
+		//Locked only once registered, so that the caller's SourceLocks always releases it
+		if(source.pIndexArray)
+			sources.back().pLockedIndices = source.pIndexArray->GetLocked(FbxLayerElementArray::eReadLock);
 	}
 
 	void Optimize(void)
 	{
-		//No data or already optimized => skip
-		if(data.empty() || !indices.empty())
+		//No data => skip
+		if(data.empty())
 			return;
 
-		//Prepare index array & unique data array
-		const unsigned int nrOfIndices = data.size();
-		std::vector<T> uniqueData;
-		indices.reserve(nrOfIndices);
+		//Get unique data & the index of every entry in it
+		ArenaVector<T> uniqueData;
+		ArenaVector<unsigned int> remap;
+		Deduplicate(data, uniqueData, remap);
 
-		for(auto& elem : data)
-		{
-			//See if we already have an attribute with this value
-			auto it = find(uniqueData.begin(), uniqueData.end(), elem);
-		
-			//New unique attribute => add it to the unique data array
-			if(it == uniqueData.end()){ 
-				uniqueData.push_back(elem);
-				it = uniqueData.end() - 1;
-			}
-			
-			//Add index to index array
-			indices.push_back(it - uniqueData.begin());
-		}
+		//Data without index array is stored per triangle corner, otherwise redirect the existing indices
+		if(indices.empty())
+			indices = std::move(remap);
+		else
+			for(auto& index : indices)
+				index = remap[index];
 
 		//Replace data by unique data
 		data = std::move(uniqueData);
 	}
+
+	//Append the attributes of another (optimized) mesh, offsetting its indices
+	void Append(const VertexAttribute<T>& other)
+	{
+		const unsigned int offset = data.size();
+		data.insert(data.end(), other.data.begin(), other.data.end());
+
+		indices.reserve(indices.size() + other.indices.size());
+		for(auto index : other.indices)
+			indices.push_back(offset + index);
+	}
 };
 
 struct Bone{
 	std::string Name;
 	fbxsdk::FbxAMatrix BindPose;
-	fbxsdk::FbxNode* pFbxNode;
+	fbxsdk::FbxNode* pFbxNode; //nullptr for bones loaded from the intermediate cache
 	fbxsdk::FbxCluster* pCluster;
 };
 
+//Range of the index buffer that is drawn with a single material
+struct Submesh{
+	std::string MaterialName;
+	unsigned int FirstIndex;
+	unsigned int IndexCount;
+
+	//Skeleton indices of the bones referenced by this range, empty unless bone palettes are used
+	ArenaVector<unsigned int> BonePalette;
+};
+
+//Entry of a vertex buffer, referring to the vertex attributes of a mesh
+struct Vertex{
+	unsigned int iPosition;
+	unsigned int iTexCoord;
+	unsigned int iNormal;
+	unsigned int iTangent;
+	unsigned int iBinormal;
+	unsigned int iVertexColor;
+	unsigned int iAnimData;
+	
+	bool operator==(const Vertex& ref) const
+	{
+		return iPosition == ref.iPosition
+			&& iTexCoord == ref.iTexCoord
+			&& iNormal == ref.iNormal
+			&& iTangent == ref.iTangent
+			&& iBinormal == ref.iBinormal
+			&& iVertexColor == ref.iVertexColor
+			&& iAnimData == ref.iAnimData;
+	}
+};
+
 struct Mesh
 {
 	//Contructor & destructor
@@ -168,28 +217,51 @@ struct Mesh
 	//Extract vertex attributes from the fbx sdk
 	void ExtractData(void);
 	
-	//Optimize vertex attributes for space (warning: slow)
+	//Optimize vertex attributes for space
 	void Optimize(void);
+
+	//Sample the node transform, and the bone transforms at the given points in time (fbx sdk, call from a single thread)
+	void SampleTransforms(const std::vector<double>& times);
 	
-	//Get mesh node name
-	std::string GetName(void);
-	
-	//Sample bone transforms at a specified point in time
-	std::vector<FbxAMatrix> GetBoneTransforms(double time) const;
+	//Get bone transforms at a point in time sampled by SampleTransforms
+	ArenaVector<FbxAMatrix> GetBoneTransforms(double time) const;
 	
 	//Check if this mesh is deformed
-	bool ContainsAnimationData(void);
-
-	VertexAttribute<FbxVector4> Positions;
-	VertexAttribute<FbxVector2> TexCoords;
-	VertexAttribute<FbxVector4> Normals;
-	VertexAttribute<FbxVector4> Tangents;
-	VertexAttribute<FbxVector4> Binormals;
-	VertexAttribute<FbxColor>	Colors;
+	bool ContainsAnimationData(void) const;
+
+	//Drop the last influences of vertices that are linked to more than maxInfluences bones
+	void LimitBoneInfluences(unsigned int maxInfluences);
+
+	//Transform positions and directions to world space using the node's global transform (call after Optimize & SampleTransforms)
+	void BakeTransform(void);
+
+	//Concatenate the optimized vertex attributes and triangles of another mesh with the same vertex format
+	void Append(const Mesh& other);
+
+	//Forget the objects of the fbx scene, so that the mesh outlives it (call after SampleTransforms)
+	void DetachFromScene(void);
+
+	VertexAttribute<Float3>		Positions;
+	VertexAttribute<Float2>		TexCoords;
+	VertexAttribute<Float3>		Normals;
+	VertexAttribute<Float3>		Tangents;
+	VertexAttribute<Float3>		Binormals;
+	VertexAttribute<Float4>		Colors;
 	VertexAttribute<BlendInfo>	BlendInformation;
 
 	std::vector<Bone> Skeleton;
 
+	//Material index per triangle, referring to MaterialNames
+	ArenaVector<unsigned int> TriangleMaterials;
+	std::vector<std::string> MaterialNames;
+
+	//Mesh node name
+	std::string Name;
+
+	//Transforms sampled from the fbx scene, nothing after SampleTransforms depends on the fbx sdk
+	FbxAMatrix GlobalTransform;
+	std::map<double, ArenaVector<FbxAMatrix> > BoneTransformsAtTime;
+
 private:
 	FbxMesh* pMesh;
 };
\ No newline at end of file
@@ -0,0 +1,448 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "WorkerPool.h"
+#include "ContentHash.h"
+#include "StringUtils.h"
+#include "pugiXML/pugixml.hpp"
+
+#include <iostream>
+#include <deque>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <stdexcept>
+#include <cstdio>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <io.h>
+#else
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <signal.h>
+	#include <cerrno>
+	#include <sys/wait.h>
+#endif
+
+using namespace std;
+using namespace pugi;
+
+//Nr of workers a job may take down before its input is quarantined, the first crash may be caused by something else
+static const unsigned int s_MaxAttempts = 2;
+
+//Nr of seconds a worker gets past the time limit of its job to cancel it, before it is ended
+//Cooking can't be cancelled, so a job that hangs in PhysX is only stopped this way
+static const unsigned int s_CancelGracePeriod = 10;
+
+FILE* WorkerPool::s_pResponses = nullptr;
+
+//Workers are started one at a time, so that none of them inherits the pipes of another
+static mutex s_SpawnMutex;
+
+// Worker process, with pipes to its stdin & stdout.
+class WorkerProcess final
+{
+public:
+	WorkerProcess(void);
+	~WorkerProcess(void);
+
+	bool Send(const string& line);
+
+	// * Waits at most timeoutMilliseconds for the next line (0 => no limit). Returns false if the worker died or the time ran out.
+	bool ReadLine(string& line, unsigned int timeoutMilliseconds);
+	bool IsTimedOut(void) const { return m_IsTimedOut; }
+
+	void Kill(void);
+
+private:
+#ifdef _WIN32
+	HANDLE m_hProcess, m_hInput, m_hOutput;
+#else
+	pid_t m_Pid;
+	int m_InputFd, m_OutputFd;
+#endif
+	string m_Received;
+	bool m_IsTimedOut;
+
+	//Disabling copy constructor & assignment operator
+	WorkerProcess(const WorkerProcess& src);
+	WorkerProcess& operator=(const WorkerProcess& src);
+};
+
+#ifdef _WIN32
+
+WorkerProcess::WorkerProcess(void):m_IsTimedOut(false)
+{
+	lock_guard<mutex> lock(s_SpawnMutex);
+
+	//Only the worker's ends of the pipes are inherited
+	SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+	HANDLE hWorkerInput, hWorkerOutput;
+	if(!CreatePipe(&hWorkerInput, &m_hInput, &security, 0))
+		throw runtime_error("Failed to create pipe");
+	if(!CreatePipe(&m_hOutput, &hWorkerOutput, &security, 0)){
+		CloseHandle(hWorkerInput);
+		CloseHandle(m_hInput);
+		throw runtime_error("Failed to create pipe");
+	}
+	SetHandleInformation(m_hInput, HANDLE_FLAG_INHERIT, 0);
+	SetHandleInformation(m_hOutput, HANDLE_FLAG_INHERIT, 0);
+
+	char executable[MAX_PATH];
+	GetModuleFileNameA(nullptr, executable, MAX_PATH);
+	string commandLine = "\"" + string(executable) + "\" --pool-worker";
+
+	STARTUPINFOA startupInfo = { sizeof(STARTUPINFOA) };
+	startupInfo.dwFlags = STARTF_USESTDHANDLES;
+	startupInfo.hStdInput = hWorkerInput;
+	startupInfo.hStdOutput = hWorkerOutput;
+	startupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+	PROCESS_INFORMATION processInfo;
+	BOOL isStarted = CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startupInfo, &processInfo);
+	CloseHandle(hWorkerInput);
+	CloseHandle(hWorkerOutput);
+
+	if(!isStarted){
+		CloseHandle(m_hInput);
+		CloseHandle(m_hOutput);
+		throw runtime_error("Failed to start worker process");
+	}
+
+	CloseHandle(processInfo.hThread);
+	m_hProcess = processInfo.hProcess;
+}
+
+WorkerProcess::~WorkerProcess(void)
+{
+	//Closing stdin ends the worker
+	CloseHandle(m_hInput);
+	WaitForSingleObject(m_hProcess, INFINITE);
+	CloseHandle(m_hProcess);
+	CloseHandle(m_hOutput);
+}
+
+bool WorkerProcess::Send(const string& line)
+{
+	DWORD nrOfBytes;
+	return WriteFile(m_hInput, line.data(), static_cast<DWORD>(line.size()), &nrOfBytes, nullptr) && nrOfBytes == line.size();
+}
+
+bool WorkerProcess::ReadLine(string& line, unsigned int timeoutMilliseconds)
+{
+	auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMilliseconds);
+
+	size_t iLineEnd;
+	while((iLineEnd = m_Received.find('\n')) == string::npos){
+		//Anonymous pipes can't be waited on with a timeout, poll them instead
+		DWORD nrOfAvailableBytes = 0;
+		while(timeoutMilliseconds > 0 && PeekNamedPipe(m_hOutput, nullptr, 0, nullptr, &nrOfAvailableBytes, nullptr) && nrOfAvailableBytes == 0){
+			if(chrono::steady_clock::now() >= deadline){
+				m_IsTimedOut = true;
+				return false;
+			}
+			Sleep(10);
+		}
+
+		char buffer[4096];
+		DWORD nrOfBytes;
+		if(!ReadFile(m_hOutput, buffer, sizeof(buffer), &nrOfBytes, nullptr) || nrOfBytes == 0)
+			return false;
+		m_Received.append(buffer, nrOfBytes);
+	}
+
+	line = m_Received.substr(0, iLineEnd);
+	m_Received.erase(0, iLineEnd + 1);
+	return true;
+}
+
+void WorkerProcess::Kill(void)
+{
+	TerminateProcess(m_hProcess, 1);
+}
+
+#else
+
+WorkerProcess::WorkerProcess(void):m_IsTimedOut(false)
+{
+	lock_guard<mutex> lock(s_SpawnMutex);
+
+	//Writing a request to a worker that died would raise SIGPIPE and take the supervisor down with it, Send reports EPIPE instead
+	signal(SIGPIPE, SIG_IGN);
+
+	int toWorker[2], fromWorker[2];
+	if(pipe(toWorker) != 0)
+		throw runtime_error("Failed to create pipe");
+	if(pipe(fromWorker) != 0){
+		close(toWorker[0]);
+		close(toWorker[1]);
+		throw runtime_error("Failed to create pipe");
+	}
+
+	//Workers started later mustn't hold on to these pipes
+	for(int fd : { toWorker[0], toWorker[1], fromWorker[0], fromWorker[1] })
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	m_Pid = fork();
+	if(m_Pid == 0){
+		dup2(toWorker[0], STDIN_FILENO);
+		dup2(fromWorker[1], STDOUT_FILENO);
+		execl("/proc/self/exe", "/proc/self/exe", "--pool-worker", static_cast<char*>(nullptr));
+		_exit(127);
+	}
+
+	close(toWorker[0]);
+	close(fromWorker[1]);
+	m_InputFd = toWorker[1];
+	m_OutputFd = fromWorker[0];
+
+	if(m_Pid < 0){
+		close(m_InputFd);
+		close(m_OutputFd);
+		throw runtime_error("Failed to start worker process");
+	}
+}
+
+WorkerProcess::~WorkerProcess(void)
+{
+	//Closing stdin ends the worker
+	close(m_InputFd);
+	waitpid(m_Pid, nullptr, 0);
+	close(m_OutputFd);
+}
+
+bool WorkerProcess::Send(const string& line)
+{
+	for(size_t written = 0; written < line.size(); ){
+		ssize_t nrOfBytes = write(m_InputFd, line.data() + written, line.size() - written);
+		if(nrOfBytes < 0 && errno == EINTR)
+			continue;
+
+		//EPIPE: the worker is gone, which the caller handles like any other dead worker
+		if(nrOfBytes <= 0)
+			return false;
+		written += nrOfBytes;
+	}
+	return true;
+}
+
+bool WorkerProcess::ReadLine(string& line, unsigned int timeoutMilliseconds)
+{
+	auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMilliseconds);
+
+	size_t iLineEnd;
+	while((iLineEnd = m_Received.find('\n')) == string::npos){
+		if(timeoutMilliseconds > 0){
+			auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+			pollfd pfd = { m_OutputFd, POLLIN, 0 };
+			if(remaining <= 0 || poll(&pfd, 1, static_cast<int>(remaining)) == 0){
+				m_IsTimedOut = true;
+				return false;
+			}
+		}
+
+		char buffer[4096];
+		ssize_t nrOfBytes = read(m_OutputFd, buffer, sizeof(buffer));
+		if(nrOfBytes <= 0)
+			return false;
+		m_Received.append(buffer, nrOfBytes);
+	}
+
+	line = m_Received.substr(0, iLineEnd);
+	m_Received.erase(0, iLineEnd + 1);
+	return true;
+}
+
+void WorkerProcess::Kill(void)
+{
+	kill(m_Pid, SIGKILL);
+}
+
+#endif
+
+//Constructor & Destructor
+//************************
+
+WorkerPool::WorkerPool(unsigned int nrOfWorkers, const string& quarantineFilename):
+	m_NrOfWorkers(nrOfWorkers > 0 ? nrOfWorkers : max(thread::hardware_concurrency(), 1u)),
+	m_QuarantineFilename(quarantineFilename)
+{
+	xml_document doc;
+	if(doc.load_file(m_QuarantineFilename.c_str()).status != status_ok)
+		return;
+
+	for(auto& fileNode : doc.first_child().children(PUGIXML_TEXT("File")))
+		m_Quarantine[FromXml(fileNode.attribute(PUGIXML_TEXT("Name")).value())] = ContentHash::FromString(FromXml(fileNode.attribute(PUGIXML_TEXT("Hash")).value()));
+}
+
+WorkerPool::~WorkerPool(void)
+{}
+
+//Methods
+//*******
+
+void WorkerPool::Run(const vector<ConversionJob>& jobs, const vector<string>& requests, const ConversionCoordinator::JobFinishedCallback& onFinished)
+{
+	mutex queueMutex;
+	deque<unsigned int> queue;
+	vector<unsigned int> attempts(jobs.size(), 0);
+
+	for(unsigned int iJob=0; iJob < jobs.size(); ++iJob)
+		queue.push_back(iJob);
+
+	//Every thread feeds a worker process of its own, and replaces it when it dies
+	auto feedWorker = [&]{
+		unique_ptr<WorkerProcess> pWorker;
+
+		for(;;){
+			unsigned int iJob;
+			{
+				lock_guard<mutex> lock(queueMutex);
+				if(queue.empty())
+					return;
+				iJob = queue.front();
+				queue.pop_front();
+				++attempts[iJob];
+			}
+
+			auto& job = jobs[iJob];
+			string response;
+			try{
+				if(!pWorker)
+					pWorker.reset(new WorkerProcess());
+			}
+			catch(exception& e){
+				cout << "\nConversion of " << job.InputFilename << " failed: " << e.what() << "\n\n";
+				onFinished(job, JobStatus::Failed, vector<string>(), 0);
+				continue;
+			}
+
+			unsigned int timeout = job.TimeLimit > 0 ? static_cast<unsigned int>((job.TimeLimit + s_CancelGracePeriod) * 1000) : 0;
+			auto startTime = chrono::steady_clock::now();
+			if(pWorker->Send(requests[iJob] + "\n") && pWorker->ReadLine(response, timeout)){
+				double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+				auto fields = SplitFields(response);
+				if(!fields.empty() && fields[0] == "OK"){
+					onFinished(job, JobStatus::Converted, vector<string>(fields.begin() + 1, fields.end()), seconds);
+				}
+				else{
+					cout << "\nConversion of " << job.InputFilename << " failed: " << (fields.size() > 1 ? fields[1] : response) << "\n\n";
+					onFinished(job, !fields.empty() && fields[0] == "CANCELLED" ? JobStatus::Cancelled : JobStatus::Failed, vector<string>(), 0);
+				}
+				continue;
+			}
+
+			//The worker is stuck in a part of the conversion that can't be cancelled
+			if(pWorker->IsTimedOut()){
+				pWorker->Kill();
+				pWorker.reset();
+				cout << "\nConversion of " << job.InputFilename << " failed: it didn't stop at its time limit, ended its worker.\n\n";
+				onFinished(job, JobStatus::Cancelled, vector<string>(), 0);
+				continue;
+			}
+
+			//The worker died on this job, retry it on a fresh worker before blaming the file
+			pWorker.reset();
+			{
+				lock_guard<mutex> lock(queueMutex);
+				if(attempts[iJob] < s_MaxAttempts){
+					cout << "Worker died while converting " << job.InputFilename << ", restarting it.\n";
+					queue.push_back(iJob);
+					continue;
+				}
+			}
+
+			cout << "\nConversion of " << job.InputFilename << " failed: it took down " << s_MaxAttempts << " workers, quarantining it.\n\n";
+			Quarantine(job);
+			onFinished(job, JobStatus::Failed, vector<string>(), 0);
+		}
+	};
+
+	vector<thread> threads;
+	for(unsigned int i=0; i < min<size_t>(m_NrOfWorkers, jobs.size()); ++i)
+		threads.push_back(thread(feedWorker));
+
+	for(auto& workerThread : threads)
+		workerThread.join();
+
+	SaveQuarantine();
+}
+
+bool WorkerPool::IsQuarantined(const ConversionJob& job) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	auto it = m_Quarantine.find(job.InputFilename);
+	if(it == m_Quarantine.end())
+		return false;
+
+	ContentHash hash;
+	return hash.UpdateWithFile(job.InputFilename) && hash.Get() == it->second;
+}
+
+void WorkerPool::Quarantine(const ConversionJob& job)
+{
+	ContentHash hash;
+	hash.UpdateWithFile(job.InputFilename);
+
+	lock_guard<mutex> lock(m_Mutex);
+	m_Quarantine[job.InputFilename] = hash.Get();
+}
+
+void WorkerPool::SaveQuarantine(void) const
+{
+	lock_guard<mutex> lock(m_Mutex);
+
+	xml_document doc;
+	auto root = doc.append_child(PUGIXML_TEXT("Quarantine"));
+
+	for(auto& entry : m_Quarantine){
+		auto fileNode = root.append_child(PUGIXML_TEXT("File"));
+		fileNode.append_attribute(PUGIXML_TEXT("Name")).set_value(ToXml(entry.first).c_str());
+		fileNode.append_attribute(PUGIXML_TEXT("Hash")).set_value(ToXml(ContentHash::ToString(entry.second)).c_str());
+	}
+
+	if(!doc.save_file(m_QuarantineFilename.c_str()))
+		cout << "Unable to write " << m_QuarantineFilename << ".\n";
+}
+
+void WorkerPool::RedirectOutput(void)
+{
+	fflush(stdout);
+#ifdef _WIN32
+	s_pResponses = _fdopen(_dup(_fileno(stdout)), "wb");
+	_dup2(_fileno(stderr), _fileno(stdout));
+#else
+	s_pResponses = fdopen(dup(STDOUT_FILENO), "w");
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+#endif
+}
+
+void WorkerPool::ServeSupervisor(ConversionServer& server, const ConversionServer::RequestHandler& handler)
+{
+	if(!s_pResponses)
+		RedirectOutput();
+
+	string request;
+	while(getline(cin, request)){
+		fputs(server.HandleRequest(request, handler).c_str(), s_pResponses);
+		fflush(s_pResponses);
+	}
+}
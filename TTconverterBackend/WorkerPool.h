@@ -0,0 +1,67 @@
+// Copyright  2013 Tom Tondeur
+// 
+// This file is part of tt::Converter.
+// 
+// tt::Converter is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// tt::Converter is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with tt::Converter.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include "ConversionJob.h"
+#include "ConversionServer.h"
+#include "ConversionCoordinator.h"
+
+// Converts jobs in worker processes, so that an fbx file that crashes the fbx sdk or PhysX only takes down a single worker.
+// Workers are started from this executable with --pool-worker, they read requests from stdin and answer on stdout (see ConversionServer.h).
+// Dead workers are restarted, a file that kills its worker twice is quarantined until it changes.
+// A worker that doesn't cancel its job shortly after the job's time limit is ended.
+class WorkerPool final
+{
+public:
+	// * nrOfWorkers: nr of worker processes (0 => nr of hardware threads)
+	// * quarantineFilename: list of inputs that crashed their workers, kept between batches
+	WorkerPool(unsigned int nrOfWorkers, const std::string& quarantineFilename);
+	~WorkerPool(void);
+
+	// * Converts the jobs in the worker processes, requests[i] is the FbxFile element of jobs[i].
+	// * onFinished is called on the thread that feeds the job's worker.
+	void Run(const std::vector<ConversionJob>& jobs, const std::vector<std::string>& requests, const ConversionCoordinator::JobFinishedCallback& onFinished);
+
+	// * Checks if the input of the job crashed a worker before, and didn't change since.
+	bool IsQuarantined(const ConversionJob& job) const;
+
+	// * First call of a worker process: keeps stdout for responses, everything else that is printed goes to stderr from now on.
+	static void RedirectOutput(void);
+
+	// * Body of a worker process: handles the requests on stdin with the server until stdin is closed.
+	static void ServeSupervisor(ConversionServer& server, const ConversionServer::RequestHandler& handler);
+
+private:
+	unsigned int m_NrOfWorkers;
+	std::string m_QuarantineFilename;
+	std::map<std::string, unsigned long long> m_Quarantine; //Input filename => hash of its content
+	mutable std::mutex m_Mutex;
+	static FILE* s_pResponses;
+
+	void Quarantine(const ConversionJob& job);
+	void SaveQuarantine(void) const;
+
+	//Disabling copy constructor & assignment operator
+	WorkerPool(const WorkerPool& src);
+	WorkerPool& operator=(const WorkerPool& src);
+};
@@ -20,15 +20,45 @@
 #include <tchar.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <map>
+#include <list>
+#include <unordered_map>
 #include <algorithm>
+#include <numeric>
+#include <memory>
+#include <stdexcept>
+#include <chrono>
+#include <cmath>
 
 #include "FileOutput.h"
 #include "FbxFileReader.h"
 #include "VertexAttributes.h"
 #include "PhysxUserStream.h"
+#include "Parallel.h"
+#include "BonePalette.h"
+#include "ConversionArena.h"
+#include "ConversionJob.h"
+#include "BatchScheduler.h"
+#include "ConversionCache.h"
+#include "IntermediateCache.h"
+#include "ContentStore.h"
+#include "ContentHash.h"
+#include "FileWatcher.h"
+#include "ConversionServer.h"
+#include "ShardReport.h"
+#include "ConversionCoordinator.h"
+#include "ConversionWorker.h"
+#include "WorkerPool.h"
+#include "CancellationToken.h"
+#include "JobHistory.h"
+#include "CostModel.h"
+#include "ConversionReport.h"
+#include "Trace.h"
+#include "AllocationTracker.h"
+#include "PerfCounters.h"
 
 #include "pugiXML/pugixml.hpp"
 
@@ -39,6 +69,8 @@
 #include <PxFoundation.h>
 #include <PxPhysics.h>
 #include <cooking/PxCooking.h>
+#include <extensions/PxDefaultAllocator.h>
+#include <extensions/PxDefaultErrorCallback.h>
 
 using namespace std;
 using namespace pugi;
@@ -50,50 +82,99 @@ using namespace physx;
 	typedef string tstring;
 #endif
 
-// Class definitions
-//******************
-struct Vertex{
-	unsigned int iPosition;
-	unsigned int iTexCoord;
-	unsigned int iNormal;
-	unsigned int iTangent;
-	unsigned int iBinormal;
-	unsigned int iVertexColor;
-	unsigned int iAnimData;
-	
-	bool operator==(const Vertex& ref) const
-	{
-		return iPosition == ref.iPosition
-			&& iTexCoord == ref.iTexCoord
-			&& iNormal == ref.iNormal
-			&& iTangent == ref.iTangent
-			&& iBinormal == ref.iBinormal
-			&& iVertexColor == ref.iVertexColor
-			&& iAnimData == ref.iAnimData;
-	}
-};
-
-struct AnimClip{
-	string Name;
-	float FramesPerSecond;
-	map<double, vector<fbxsdk::FbxAMatrix> > TransformsAtTimeStamps;
-};
-
-enum class CollisionGeneration{
-	Convex,
-	Concave,
-	None
-};
-
 //Forward declaration
 //*******************
-void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& animClips, CollisionGeneration generateCollision);
+ConversionJob ReadJob(const xml_node& node, const ConversionJob& batchSettings, const string& outputPath);
+vector<string> ConvertFbxFile(const ConversionJob& job, vector<AnimClip>& animClips, const ConversionContext& context, unique_ptr<ConversionReport>* pReport = nullptr);
+void WriteMesh(Mesh& mesh, string outFilename, vector<AnimClip>& animClips, CollisionGeneration generateCollision, unsigned int bonePaletteSize, const ContentStore& store, PxCooking* pSharedCooker);
+void BuildBuffers(const Mesh& mesh, ArenaVector<Vertex>& vertexBuffer, ArenaVector<unsigned int>& indexBuffer, ArenaVector<Submesh>& submeshes);
+unsigned int GetVertexFormat(const Mesh& mesh);
+void ReportElementCounts(const Mesh& mesh, const string& suffix);
+void ReportFileSize(const string& name, const string& filename);
 
 // Entrypoint
 //***********
 int main(int argc, char** argv) 
 {
-	vector<AnimClip> animClips;	
+	//Keep running after the batch, converting files again whenever they change
+	bool watch = false;
+	//Serve conversion requests on a local socket instead of converting the batch
+	string serverAddress;
+	//Only convert the jobs of one shard of the batch (--shard i/n, 0 <= i < n)
+	unsigned int shardIndex = 0, shardCount = 0;
+	//Assignment of the jobs to the shards, written once (--plan-shards n) and used by every shard (--shard-plan file)
+	unsigned int planShardCount = 0;
+	string shardPlanFilename;
+	//Hand out the jobs to workers connecting on a TCP port (--coordinator [interface:]port, loopback by default), or be such a worker (--worker host:port)
+	string coordinatorAddress = "127.0.0.1";
+	unsigned short coordinatorPort = 0;
+	string workerHost;
+	unsigned short workerPort = 0;
+	//Convert the requests of a WorkerPool on stdin
+	bool poolWorker = false;
+	//Merge the reports of all shards instead of converting
+	vector<string> shardReportFilenames;
+	bool mergeShards = false;
+	//Record a timeline of the conversion stages, written when the batch ends (and replaced by the timeline of every round of changes while watching)
+	string traceFilename;
+
+	for(int i=1; i < argc; ++i){
+		string arg = argv[i];
+		if(arg == "--watch")
+			watch = true;
+		else if(arg == "--serve" && i + 1 < argc)
+			serverAddress = argv[++i];
+		else if(arg == "--shard" && i + 1 < argc){
+			string shard = argv[++i];
+			auto iSlash = shard.find('/');
+			shardIndex = iSlash == string::npos ? 0 : atoi(shard.substr(0, iSlash).c_str());
+			shardCount = iSlash == string::npos ? 0 : atoi(shard.substr(iSlash + 1).c_str());
+
+			if(shardCount == 0 || shardIndex >= shardCount){
+				cout << "Invalid shard " << shard << ", expected i/n with 0 <= i < n.\n";
+				return 1;
+			}
+		}
+		else if(arg == "--plan-shards" && i + 1 < argc)
+			planShardCount = atoi(argv[++i]);
+		else if(arg == "--shard-plan" && i + 1 < argc)
+			shardPlanFilename = argv[++i];
+		else if(arg == "--coordinator" && i + 1 < argc){
+			string address = argv[++i];
+			auto iColon = address.find_last_of(':');
+			if(iColon != string::npos)
+				coordinatorAddress = address.substr(0, iColon);
+			coordinatorPort = static_cast<unsigned short>(atoi(address.substr(iColon == string::npos ? 0 : iColon + 1).c_str()));
+		}
+		else if(arg == "--worker" && i + 1 < argc){
+			string address = argv[++i];
+			auto iColon = address.find_last_of(':');
+			workerHost = address.substr(0, iColon);
+			workerPort = iColon == string::npos ? 0 : static_cast<unsigned short>(atoi(address.substr(iColon + 1).c_str()));
+		}
+		else if(arg == "--pool-worker")
+			poolWorker = true;
+		else if(arg == "--trace" && i + 1 < argc)
+			traceFilename = argv[++i];
+		else if(arg == "--merge-shards"){
+			mergeShards = true;
+			while(i + 1 < argc)
+				shardReportFilenames.push_back(argv[++i]);
+		}
+	}
+
+	//The trace is written when the batch ends, a server only ends when it is killed
+	if(!traceFilename.empty() && (!serverAddress.empty() || poolWorker)){
+		cout << "--trace can't be combined with --serve or --pool-worker.\n";
+		return 1;
+	}
+
+	if(!traceFilename.empty())
+		Trace::Start();
+
+	//Responses to the supervisor mustn't get mixed up with the output of the converter
+	if(poolWorker)
+		WorkerPool::RedirectOutput();
 
 	//Try to load batch.xml
 	xml_document doc;
@@ -101,6 +182,10 @@ int main(int argc, char** argv)
 
 	if(result.status != xml_parse_status::status_ok){
 		cout << "Unable to read batch.xml.\n";
+
+		//Worker processes have no console to wait for, their supervisor sees them exit
+		if(poolWorker)
+			return 1;
 		system("pause");
 		return 0;
 	}
@@ -109,130 +194,668 @@ int main(int argc, char** argv)
 	tstring oPath = doc.first_child().child(_T("Output")).child_value();
 	string oPathName = string(oPath.begin(), oPath.end());
 
+	//Memory budget (MB) & max nr of jobs running at once, 0 or missing => based on the machine
+	size_t memoryBudget = static_cast<size_t>(doc.first_child().child(_T("MemoryBudget")).text().as_uint()) * 1024 * 1024;
+	unsigned int maxConcurrentJobs = doc.first_child().child(_T("MaxConcurrentJobs")).text().as_uint();
+
+	//Working set limit (MB) of out-of-core conversion, 0 or missing => in-core
+	size_t outOfCoreLimit = static_cast<size_t>(doc.first_child().child(_T("OutOfCoreLimit")).text().as_uint()) * 1024 * 1024;
+	tstring scratchDir = doc.first_child().child(_T("ScratchDirectory")).child_value();
+	string scratchDirectory = scratchDir.empty() ? oPathName : string(scratchDir.begin(), scratchDir.end());
+
+	//Directory to cache extracted mesh data in, empty or missing => no caching
+	tstring cacheDir = doc.first_child().child(_T("IntermediateCache")).child_value();
+	string cacheDirectory(cacheDir.begin(), cacheDir.end());
+
+	//Directory of the content store for outputs, empty or missing => outputs aren't deduplicated
+	tstring storeDir = doc.first_child().child(_T("ContentStore")).child_value();
+	string storeDirectory(storeDir.begin(), storeDir.end());
+
+	//Check if files that are unchanged since their last conversion should be skipped
+	bool incremental = doc.first_child().child(_T("Incremental")).text().as_bool();
+
+	//Max nr of seconds a single file may take (0 or missing => no limit), FbxFile elements can override it with Timeout
+	double jobTimeout = doc.first_child().child(_T("JobTimeout")).text().as_double();
+
+	//Secret shared by the coordinator & workers of a distributed batch, required for both
+	tstring farmTok = doc.first_child().child(_T("FarmToken")).child_value();
+	string farmToken(farmTok.begin(), farmTok.end());
+	if((coordinatorPort > 0 || !workerHost.empty()) && farmToken.empty()){
+		cout << "Distributed batches need a FarmToken in batch.xml.\n";
+		return 1;
+	}
+
+	//Check if jobs should be converted in worker processes, so that a file that crashes the converter doesn't end the batch
+	bool isolateJobs = doc.first_child().child(_T("IsolateJobs")).text().as_bool();
+
+	//Check if every job should write a timing & statistics report, collected in a report of the batch
+	bool writeReports = doc.first_child().child(_T("Report")).text().as_bool();
+
+	//Check if the reports should include the bytes allocated per stage & the peak memory use
+	if(writeReports && doc.first_child().child(_T("TrackAllocations")).text().as_bool())
+		AllocationTracker::Enable();
+
+	//Check if the reports should include hardware counts per stage (cycles, instructions, cache & branch misses, Linux only)
+	if(writeReports && doc.first_child().child(_T("PerfCounters")).text().as_bool())
+		PerfCounters::Enable();
+
+	//Settings shared by all fbx files
+	ConversionJob batchSettings;
+	batchSettings.OutOfCoreLimit = outOfCoreLimit;
+	batchSettings.ScratchDirectory = scratchDirectory;
+	batchSettings.IntermediateCacheDirectory = cacheDirectory;
+	batchSettings.ContentStoreDirectory = storeDirectory;
+	batchSettings.TimeLimit = jobTimeout;
+	batchSettings.WriteReport = writeReports;
+
 	//Read all fbx files
-	for(auto& node : doc.first_child().children(_T("FbxFile")))
-	{		
-		//Get filename
-		tstring iFile = node.child(_T("Filename")).child_value();
-		string iFilename(iFile.begin(), iFile.end());
-
-		//Get type of collision to generate
-		CollisionGeneration generateCollision;
-		auto colGenNode = node.child(_T("CollisionGeneration"));
-		if(colGenNode.child_value() == _T("Concave"))
-			generateCollision = CollisionGeneration::Concave;
-		else if(colGenNode.child_value() == _T("Convex"))
-			generateCollision = CollisionGeneration::Convex;
-		else
-			generateCollision = CollisionGeneration::None;
+	vector<ConversionJob> jobs;
+	map<string, string> requestPerOutput; //FbxFile elements on a single line, sent to the workers of a distributed batch
+	for(auto& node : doc.first_child().children(_T("FbxFile"))){
+		try{
+			jobs.push_back(ReadJob(node, batchSettings, oPathName));
+		}
+		catch(runtime_error& e){
+			cout << "Skipping an FbxFile of batch.xml: " << e.what() << "\n";
+			continue;
+		}
+
+		ostringstream request;
+		node.print(request, PUGIXML_TEXT(""), format_raw, encoding_utf8);
+		requestPerOutput[jobs.back().OutputFilename] = request.str();
+	}
+
+	//Check that the shards converted the whole batch between them
+	if(mergeShards){
+		bool isComplete = ShardReport::Merge(shardReportFilenames, jobs, "batchreport.xml");
+		cout << (isComplete ? "All jobs of the batch were converted.\n" : "The batch wasn't converted completely.\n");
+		return isComplete ? 0 : 1;
+	}
+
+	//Balance the shards on the input files of this machine, once, the plan is handed to every shard
+	if(planShardCount > 0){
+		string planFilename = shardPlanFilename.empty() ? "shardplan.xml" : shardPlanFilename;
+		ShardReport::SavePlan(planFilename, jobs, ShardReport::AssignShards(jobs, planShardCount), planShardCount);
+		cout << "Wrote the plan of " << planShardCount << " shards to " << planFilename << ".\n";
+		return 0;
+	}
+
+	//Keep the jobs of this shard. Every shard must come to the same split of the batch: without a plan, each shard balances
+	//the batch on its own input files, which agree as long as the shards share the same inputs.
+	ShardReport shardReport(shardIndex, max(shardCount, 1u));
+	if(shardCount > 0){
+		vector<unsigned int> shards;
+		if(shardPlanFilename.empty())
+			shards = ShardReport::AssignShards(jobs, shardCount);
+		else if(!ShardReport::LoadPlan(shardPlanFilename, jobs, shardCount, shards))
+			return 1;
+		vector<ConversionJob> shardJobs;
+		for(unsigned int iJob=0; iJob < jobs.size(); ++iJob)
+			if(shards[iJob] == shardIndex)
+				shardJobs.push_back(jobs[iJob]);
+		jobs.swap(shardJobs);
+
+		cout << "Converting " << jobs.size() << " jobs of shard " << shardIndex << "/" << shardCount << ".\n";
+	}
+
+	//Collision meshes are cooked through the PhysX foundation, shared by all jobs
+	PxDefaultAllocator physxAllocator;
+	PxDefaultErrorCallback physxErrorCallback;
+	PxFoundation* pFoundation = PxCreateFoundation(PX_PHYSICS_VERSION, physxAllocator, physxErrorCallback);
+
+	//Skip jobs of which neither the input nor the settings changed since their outputs were written
+	ConversionCache cache("conversioncache.xml");
+
+	//Servers & workers receive a single FbxFile element per request, the batch.xml settings apply to all of them
+	//Workers always convert, their coordinator or supervisor only hands out jobs that aren't up to date
+	const bool skipUpToDateRequests = incremental && workerHost.empty() && !poolWorker;
+	auto handleRequest = [&](const string& request, const ConversionContext& context){
+		xml_document requestDoc;
+		if(requestDoc.load_buffer(request.data(), request.size(), parse_default, encoding_utf8).status != status_ok)
+			throw runtime_error("Request is not a valid FbxFile element");
+
+		ConversionJob job = ReadJob(requestDoc.child(_T("FbxFile")), batchSettings, oPathName);
+		if(job.InputFilename.empty())
+			throw runtime_error("Request has no Filename");
+
+		//Up to date jobs are answered without outputs
+		if(skipUpToDateRequests){
+			job.InputHash = ConversionCache::ComputeInputHash(job.InputFilename);
+			job.JobHash = ConversionCache::ComputeJobHash(job);
+			if(cache.IsUpToDate(job, job.JobHash))
+				return vector<string>();
+		}
+
+		vector<AnimClip> animClips = job.AnimClips;
+		auto outputFiles = ConvertFbxFile(job, animClips, context);
+
+		if(skipUpToDateRequests)
+			cache.Update(job, job.JobHash, outputFiles);
+		return outputFiles;
+	};
+
+	if(!serverAddress.empty() || poolWorker){
+		//Rewriting the whole manifest after every request doesn't scale, it is saved periodically & when the server stops
+		if(skipUpToDateRequests)
+			cache.EnableAutoSave(30);
 
-		//Read all animclips
-		for(auto& animClipNode : node.children(_T("AnimClip")))
 		{
-			animClips.push_back(AnimClip());
-			AnimClip& newClip = animClips.back();
+			//A pool worker converts a single job at a time
+			ConversionServer server(serverAddress, poolWorker ? 1 : maxConcurrentJobs);
+			if(outOfCoreLimit > 0)
+				server.EnableOutOfCore(scratchDirectory, outOfCoreLimit);
 
-			//Get clip name
-			tstring clipName = animClipNode.child(_T("Name")).child_value();
-			newClip.Name = string(clipName.begin(), clipName.end());
-			
-			//Get begin and end keyframe
-			auto keyFrameNode = animClipNode.child(_T("Keyframes"));
-			double firstKey = keyFrameNode.attribute(_T("Begin")).as_double();
-			double lastKey  = keyFrameNode.attribute(_T("End")).as_double();
+			if(poolWorker)
+				WorkerPool::ServeSupervisor(server, handleRequest);
+			else
+				server.Run(handleRequest);
+		}
 
-			//Get FPS
-			newClip.FramesPerSecond = static_cast<float>(keyFrameNode.attribute(_T("FPS")).as_double());
-			
-			//Prepare animclip container, where we will store the sampled bone transforms
-			double interval = 2.0/newClip.FramesPerSecond;
-			for(double time = firstKey; time < lastKey + interval*0.5; time += interval)
-				newClip.TransformsAtTimeStamps.insert(make_pair(time, vector<FbxAMatrix>() ) );
+		pFoundation->release();
+		return 0;
+	}
+
+	if(!workerHost.empty()){
+		ConversionWorker worker(workerHost, workerPort, maxConcurrentJobs, oPathName, farmToken);
+		worker.Run(handleRequest);
+
+		if(!traceFilename.empty())
+			Trace::Save(traceFilename);
+
+		pFoundation->release();
+		return 0;
+	}
+
+	WorkerPool pool(maxConcurrentJobs, "quarantine.xml");
+	vector<ConversionJob> pendingJobs;
+	for(auto& job : jobs){
+		if(isolateJobs && pool.IsQuarantined(job)){
+			cout << job.InputFilename << " is quarantined, it crashed the converter before.\n";
+			shardReport.Record(job, JobStatus::Failed, vector<string>());
+			continue;
 		}
-		//Get filename to output (no extension)
-		string oFilename = oPathName + iFilename.substr(iFilename.find_last_of('\\')+1, iFilename.find_last_of('.') - iFilename.find_last_of('\\') - 1);
 
-		//Convert an fbx file
-		ConvertFbxFile(iFilename, oFilename, animClips, generateCollision);
+		if(incremental){
+			job.InputHash = ConversionCache::ComputeInputHash(job.InputFilename);
+			job.JobHash = ConversionCache::ComputeJobHash(job);
+
+			if(cache.IsUpToDate(job, job.JobHash)){
+				cout << job.InputFilename << " is up to date.\n";
+				shardReport.Record(job, JobStatus::UpToDate, vector<string>());
+				continue;
+			}
+		}
+		pendingJobs.push_back(job);
 	}
 
-	::system("pause");
-    return 0;
+	//Start the longest jobs first, so that the batch doesn't end with a single long job running on its own
+	//Peaks & times of earlier conversions, recorded per input file for the scheduler & the cost model
+	JobHistory jobHistory("jobhistory.xml");
+	CostModel costModel(&jobHistory);
+	vector<JobFeatures> pendingFeatures(pendingJobs.size());
+	ParallelFor(0, pendingJobs.size(), [&](unsigned int iJob){
+		//Recorded times are matched on the contents of the input, incremental batches hashed them already
+		if(pendingJobs[iJob].InputHash == 0)
+			pendingJobs[iJob].InputHash = ConversionCache::ComputeInputHash(pendingJobs[iJob].InputFilename);
+		pendingFeatures[iJob] = CostModel::Scan(pendingJobs[iJob]);
+	});
+
+	vector<double> estimates;
+	for(unsigned int iJob=0; iJob < pendingJobs.size(); ++iJob)
+		estimates.push_back(costModel.Estimate(pendingJobs[iJob], pendingFeatures[iJob]));
+
+	vector<unsigned int> order(pendingJobs.size());
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [&](unsigned int lhs, unsigned int rhs){ return estimates[lhs] > estimates[rhs]; });
+
+	vector<ConversionJob> sortedJobs;
+	map<string, JobFeatures> featuresPerOutput;
+	for(auto iJob : order){
+		sortedJobs.push_back(pendingJobs[iJob]);
+		featuresPerOutput[pendingJobs[iJob].OutputFilename] = pendingFeatures[iJob];
+	}
+	pendingJobs = move(sortedJobs);
+
+	BatchReport batchReport;
+
+	//Convert the fbx files on remote workers or in worker processes, as soon as one of them is available
+	if(coordinatorPort > 0 || isolateJobs){
+		vector<string> requests;
+		for(auto& job : pendingJobs)
+			requests.push_back(requestPerOutput[job.OutputFilename]);
+
+		auto recordResult = [&](const ConversionJob& job, JobStatus status, const vector<string>& outputFiles, double seconds){
+			if(status == JobStatus::Converted)
+				jobHistory.RecordTime(job, featuresPerOutput.at(job.OutputFilename), seconds);
+			shardReport.Record(job, status, outputFiles);
+			if(writeReports && status == JobStatus::Converted)
+				batchReport.Add(job);
+			if(incremental && status == JobStatus::Converted)
+				cache.Update(job, job.JobHash, outputFiles);
+		};
+
+		if(coordinatorPort > 0){
+			ConversionCoordinator coordinator(coordinatorAddress, coordinatorPort, oPathName, farmToken);
+			coordinator.Run(pendingJobs, requests, recordResult);
+		}
+		else
+			pool.Run(pendingJobs, requests, recordResult);
+
+		pendingJobs.clear();
+	}
+
+	//Convert the fbx files, running as many at once as the memory budget allows.
+	//Every job uses an fbx manager of its own, imports are serialized by FbxFileReader and extraction assumes that separate managers share no state.
+	BatchScheduler scheduler(memoryBudget, maxConcurrentJobs, jobHistory);
+	ConversionContext jobContext = { nullptr, nullptr };
+	scheduler.Run(pendingJobs, [&](const ConversionJob& job){
+		//Sampled transforms are stored in a copy of the clips. The copied vectors are empty heap vectors,
+		//the transforms assigned to them by WriteMesh bring the allocator of the job's arena along.
+		vector<AnimClip> animClips = job.AnimClips;
+		vector<string> outputFiles;
+		unique_ptr<ConversionReport> pReport;
+		auto startTime = chrono::steady_clock::now();
+		try{
+			outputFiles = ConvertFbxFile(job, animClips, jobContext, &pReport);
+		}
+		catch(JobCancelled&){
+			shardReport.Record(job, JobStatus::Cancelled, vector<string>());
+			throw;
+		}
+		catch(...){
+			shardReport.Record(job, JobStatus::Failed, vector<string>());
+			throw;
+		}
+		shardReport.Record(job, JobStatus::Converted, outputFiles);
+		jobHistory.RecordTime(job, featuresPerOutput.at(job.OutputFilename), chrono::duration<double>(chrono::steady_clock::now() - startTime).count());
+		if(pReport)
+			batchReport.Add(move(pReport));
+		
+		if(incremental)
+			cache.Update(job, job.JobHash, outputFiles);
+	});
+
+	jobHistory.Save();
+
+	if(writeReports)
+		batchReport.Save(shardCount > 0 ? "timingreport" + to_string(shardIndex) + ".json" : "timingreport.json");
+
+	if(!traceFilename.empty())
+		Trace::Save(traceFilename);
+
+	if(incremental)
+		cache.Save();
+
+	if(shardCount > 0)
+		shardReport.Save("shardreport" + to_string(shardIndex) + ".xml");
+
+	if(!watch){
+		pFoundation->release();
+		::system("pause");
+		return 0;
+	}
+
+	//Changed files are converted one at a time, reusing the fbx manager, the cooker and the arena of earlier conversions
+	PxCookingParams cookingParams{ PxTolerancesScale() };
+	ConversionContext watchContext;
+	watchContext.pFbxManager = FbxFileReader::CreateSdkManager();
+	watchContext.pCooker = PxCreateCooking(PX_PHYSICS_VERSION, *pFoundation, cookingParams);
+
+	ConversionArena arena(outOfCoreLimit > 0 ? 256 * 1024 * 1024 : 16 * 1024 * 1024);
+	if(outOfCoreLimit > 0)
+		arena.EnableOutOfCore(scratchDirectory, outOfCoreLimit);
+
+	vector<string> inputFilenames;
+	for(auto& job : jobs)
+		inputFilenames.push_back(job.InputFilename);
+	FileWatcher watcher(inputFilenames);
+
+	//Editors write a file in several steps, wait until it is left alone before converting it
+	const unsigned int debounceMilliseconds = 100;
+	for(;;){
+		cout << "Watching " << jobs.size() << " files for changes...\n";
+
+		for(auto iJob : watcher.WaitForChanges(debounceMilliseconds)){
+			auto& job = jobs[iJob];
+
+			try{
+				ArenaScope arenaScope(&arena);
+				if(incremental){
+					job.InputHash = ConversionCache::ComputeInputHash(job.InputFilename);
+					job.JobHash = ConversionCache::ComputeJobHash(job);
+				}
+
+				vector<AnimClip> animClips = job.AnimClips;
+				auto outputFiles = ConvertFbxFile(job, animClips, watchContext);
+
+				if(incremental)
+					cache.Update(job, job.JobHash, outputFiles);
+			}
+			catch(exception& e){
+				cout << "\nConversion of " << job.InputFilename << " failed: " << e.what() << "\n\n";
+			}
+
+			arena.Reset();
+		}
+
+		if(incremental)
+			cache.Save();
+
+		//Replaced by the zones of every round of changes, the watcher only stops when it is killed
+		if(!traceFilename.empty())
+			Trace::Save(traceFilename);
+	}
 }
 
-void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& animClips, CollisionGeneration generateCollision)
+//Read the settings of a single fbx file (an FbxFile element of batch.xml), settings shared by all files are taken from batchSettings
+ConversionJob ReadJob(const xml_node& node, const ConversionJob& batchSettings, const string& outputPath)
 {
-	Mesh mesh;
+	ConversionJob job = batchSettings;
+
+	//Get filename
+	tstring iFile = node.child(_T("Filename")).child_value();
+	job.InputFilename = string(iFile.begin(), iFile.end());
+
+	//Get type of collision to generate
+	tstring colGen = node.child(_T("CollisionGeneration")).child_value();
+	if(colGen == _T("Concave"))
+		job.GenerateCollision = CollisionGeneration::Concave;
+	else if(colGen == _T("Convex"))
+		job.GenerateCollision = CollisionGeneration::Convex;
+	else
+		job.GenerateCollision = CollisionGeneration::None;
+
+	//Check if static meshes should be merged into shared buffers
+	job.MergeStaticMeshes = node.child(_T("MergeStaticMeshes")).text().as_bool();
 
+	//Get max nr of bones per draw call for skinned meshes (0 = no limit)
+	job.BonePaletteSize = node.child(_T("BonePaletteSize")).text().as_uint();
+
+	//Get max nr of seconds the conversion may take
+	if(node.child(_T("Timeout")))
+		job.TimeLimit = node.child(_T("Timeout")).text().as_double();
+
+	//Read all animclips
+	for(auto& animClipNode : node.children(_T("AnimClip")))
 	{
-		//Get mesh from FileReader
-		FbxFileReader fbxFile(inFilename);	
-		mesh = fbxFile.GetMesh();
+		job.AnimClips.push_back(AnimClip());
+		AnimClip& newClip = job.AnimClips.back();
+
+		//Get clip name
+		tstring clipName = animClipNode.child(_T("Name")).child_value();
+		newClip.Name = string(clipName.begin(), clipName.end());
+		
+		//Get begin and end keyframe
+		auto keyFrameNode = animClipNode.child(_T("Keyframes"));
+		double firstKey = keyFrameNode.attribute(_T("Begin")).as_double();
+		double lastKey  = keyFrameNode.attribute(_T("End")).as_double();
 
-		std::cout << "\nProcessing FBX file " << inFilename << "...\n\n";
-		//Extract vertex attributes and skeleton
-		mesh.ExtractData();
+		//Get FPS
+		newClip.FramesPerSecond = static_cast<float>(keyFrameNode.attribute(_T("FPS")).as_double());
 		
-		std::cout << "Done.\nOptimizing vertex attributes... ";
-		//Remove duplicates and use indirect arrays
-		mesh.Optimize();
+		//Requests come from other processes & machines, a bad FPS would never finish the loop below and a huge range would fill the memory
+		const double maxSamplesPerClip = 1000000;
+		double interval = 2.0/newClip.FramesPerSecond;
+		if(!(newClip.FramesPerSecond > 0) || !isfinite(interval) || !isfinite(firstKey) || !isfinite(lastKey) || lastKey < firstKey)
+			throw runtime_error("AnimClip " + newClip.Name + " needs a positive FPS and End >= Begin");
+		if((lastKey - firstKey) / interval > maxSamplesPerClip)
+			throw runtime_error("AnimClip " + newClip.Name + " has too many keyframes");
 
-		std::cout << "Done.\nExtracting bone transforms... ";
-		//Get bone transforms
-		for(auto& animClip : animClips)
-			for(auto& transformAtTime : animClip.TransformsAtTimeStamps)
-				transformAtTime.second = mesh.GetBoneTransforms(transformAtTime.first);
+		//Prepare animclip container, where we will store the sampled bone transforms
+		for(double time = firstKey; time < lastKey + interval*0.5; time += interval)
+			newClip.TransformsAtTimeStamps.insert(make_pair(time, ArenaVector<FbxAMatrix>() ) );
 	}
+	job.InputHash = 0;
+	job.JobHash = 0;
 
-	std::cout << "Done.\nChecking if vertices are linked to more than 4 bones... ";
-	//Make sure none of the vertices is skinned to more than 4 bones
-	for(auto& elem : mesh.BlendInformation.data)
-		while(elem.BlendIndices.size() > 4)
+	//Get filename to output (no extension)
+	job.OutputFilename = outputPath + job.InputFilename.substr(job.InputFilename.find_last_of('\\')+1, job.InputFilename.find_last_of('.') - job.InputFilename.find_last_of('\\') - 1);
+	return job;
+}
+
+//Returns the names of the written files, the report of the job is handed to pReport if it is written
+vector<string> ConvertFbxFile(const ConversionJob& job, vector<AnimClip>& animClips, const ConversionContext& context, unique_ptr<ConversionReport>* pReport)
+{
+	//The long loops of the conversion stop with JobCancelled once the time limit runs out
+	CancellationToken cancellationToken(job.TimeLimit);
+	CancellationScope cancellationScope(&cancellationToken);
+
+	//Stages of the conversion are timed & counted only if a report is written
+	unique_ptr<ConversionReport> pJobReport(new ConversionReport());
+	ReportScope reportScope(job.WriteReport ? pJobReport.get() : nullptr);
+
+	//Zones recorded by the threads of this conversion are tagged with a job id, the zone of the whole conversion names its input
+	TraceJobScope traceJobScope(Trace::CreateJob());
+	TraceZone conversionZone("Convert", job.InputFilename);
+
+	//Every time stamp of the clips is sampled up front, nothing after extraction depends on the fbx sdk
+	vector<double> sampleTimes;
+	for(auto& animClip : animClips)
+		for(auto& transformAtTime : animClip.TransformsAtTimeStamps)
+			sampleTimes.push_back(transformAtTime.first);
+	sort(sampleTimes.begin(), sampleTimes.end());
+	sampleTimes.erase(unique(sampleTimes.begin(), sampleTimes.end()), sampleTimes.end());
+
+	//Reuse the extracted data of an earlier conversion of the same input if possible
+	IntermediateCache cache(job.IntermediateCacheDirectory);
+	unsigned long long cacheKey = cache.IsEnabled() ? IntermediateCache::ComputeKey(job, sampleTimes) : 0;
+	unique_ptr<FbxFileReader> pFbxFile;
+	vector<Mesh> cachedMeshes;
+	vector<Mesh>* pMeshes = &cachedMeshes;
+
+	if(cache.Load(cacheKey, cachedMeshes))
+		std::cout << "\nProcessing cached data of " << job.InputFilename << " (" << cachedMeshes.size() << " meshes)...\n\n";
+	else{
+		//Get all meshes from FileReader, a single import serves every mesh in the scene
 		{
-			elem.BlendIndices.pop_back();
-			elem.BlendWeights.pop_back();
+			StageScope importStage("Import");
+			pFbxFile.reset(new FbxFileReader(job.InputFilename, context.pFbxManager));
+			pMeshes = &pFbxFile->GetMeshes();
 		}
+		CancellationToken::Check();
 
-	std::cout << "Done.\nBuilding vertex- and indexbuffers... ";
-	// Construct vertexbuffer/indexBuffer
-	vector<Vertex> vertexBuffer;
-	vector<unsigned int> indexBuffer;
-	for(unsigned int i=0; i < mesh.Positions.indices.size(); ++i){
-		Vertex newVert;
-		newVert.iPosition = mesh.Positions.indices[i];
+		std::cout << "\nProcessing FBX file " << job.InputFilename << " (" << pMeshes->size() << " meshes)...\n\n";
 
-		newVert.iTexCoord =		mesh.TexCoords.indices.empty()			? 0 : mesh.TexCoords.indices[i];
-		newVert.iNormal =		mesh.Normals.indices.empty()			? 0 : mesh.Normals.indices[i];
-		newVert.iTangent =		mesh.Tangents.indices.empty()			? 0 : mesh.Tangents.indices[i];
-		newVert.iBinormal =		mesh.Binormals.indices.empty()			? 0 : mesh.Binormals.indices[i];
-		newVert.iVertexColor =	mesh.Colors.indices.empty()				? 0 : mesh.Colors.indices[i];
-		newVert.iAnimData =		mesh.BlendInformation.indices.empty()	? 0 : mesh.BlendInformation.indices[i];
+		std::cout << "Extracting vertex attributes and skeletons... ";
+		//Extract vertex attributes and skeleton one mesh after the other, the fbx sdk isn't thread-safe (every extraction is parallel internally)
+		auto& meshes = *pMeshes;
+		for(auto& mesh : meshes){
+			{
+				StageScope extractStage("Extract");
+				mesh.ExtractData();
+			}
+			ReportElementCounts(mesh, "Before");
+		}
 
-		auto it = find(vertexBuffer.begin(), vertexBuffer.end(), newVert);
+		//Remove duplicates and use indirect arrays, this only touches our own arrays (one mesh per thread).
+		//The stage surrounds the loop, so that the spawned threads are counted towards it.
+		{
+			StageScope optimizeStage("Optimize");
+			ParallelFor(0, meshes.size(), [&](unsigned int iMesh){
+				meshes[iMesh].Optimize();
+				ReportElementCounts(meshes[iMesh], "After");
+			});
+		}
+
+		//Node transforms are evaluated on this thread, the FBX evaluator is not thread-safe
+		{
+			StageScope sampleStage("Sample");
+			for(auto& mesh : meshes)
+				mesh.SampleTransforms(sampleTimes);
+		}
+
+		//Nothing after sampling touches the fbx scene, release it before the buffers are built
+		cachedMeshes = pFbxFile->TakeMeshes();
+		pMeshes = &cachedMeshes;
+		pFbxFile.reset();
+
+		cache.Store(cacheKey, cachedMeshes);
+	}
+	auto& meshes = *pMeshes;
+	ConversionReport::Count("Meshes", meshes.size());
 
-		if(it==vertexBuffer.end()){
-			vertexBuffer.push_back(newVert);
-			it = vertexBuffer.end() - 1;
+	//Collect the meshes to write, static meshes are baked and merged per vertex format if requested
+	vector<Mesh*> outputMeshes;
+	vector<string> outputNames;
+	list<Mesh> mergedMeshes;
+	map<unsigned int, Mesh*> mergedMeshPerFormat;
+
+	if(job.MergeStaticMeshes)
+		std::cout << "Done.\nMerging static meshes... ";
+
+	StageScope mergeStage(job.MergeStaticMeshes ? "Merge" : nullptr);
+	for(auto& mesh : meshes){
+		if(!job.MergeStaticMeshes || mesh.ContainsAnimationData()){
+			outputMeshes.push_back(&mesh);
+			outputNames.push_back(mesh.Name);
+			continue;
 		}
 
-		indexBuffer.push_back(it-vertexBuffer.begin());
+		mesh.BakeTransform();
+
+		const unsigned int vertexFormat = GetVertexFormat(mesh) | (mesh.TexCoords.data.empty() ? 0 : 1 << 8);
+		auto it = mergedMeshPerFormat.find(vertexFormat);
+
+		if(it == mergedMeshPerFormat.end()){
+			mergedMeshes.push_back(Mesh());
+			it = mergedMeshPerFormat.insert(make_pair(vertexFormat, &mergedMeshes.back())).first;
+			outputMeshes.push_back(it->second);
+			outputNames.push_back("static" + to_string(vertexFormat));
+		}
+
+		it->second->Append(mesh);
+	}
+
+	//Baked attributes of different meshes can be equal, so merged meshes are deduplicated once more (positions included, merged meshes aren't skinned)
+	ParallelFor(0, mergedMeshes.size(), [&](unsigned int iMesh){
+		auto it = mergedMeshes.begin();
+		advance(it, iMesh);
+		it->Positions.Optimize();
+		it->Optimize();
+	});
+	mergeStage.Stop();
+
+	std::cout << "Done.\n";
+
+	//Identical outputs of all files are stored once
+	ContentStore store(job.ContentStoreDirectory);
+
+	//Every mesh gets its own output file, suffixed with the mesh name when there is more than one output
+	vector<string> meshFilenames, outputFiles;
+	for(unsigned int iMesh=0; iMesh < outputMeshes.size(); ++iMesh){
+		string meshFilename = job.OutputFilename;
+		if(outputMeshes.size() > 1){
+			string meshName = outputNames[iMesh];
+			replace_if(meshName.begin(), meshName.end(), [](char c){ return string("\\/:*?\"<>|").find(c) != string::npos; }, '_');
+			meshFilename += "_" + meshName;
+
+			//Fall back to the mesh index for unnamed meshes and name clashes
+			if(meshName.empty() || find(meshFilenames.begin(), meshFilenames.end(), meshFilename) != meshFilenames.end())
+				meshFilename = job.OutputFilename + "_" + to_string(iMesh);
+		}
+		meshFilenames.push_back(meshFilename);
+
+		std::cout << "\nWriting " << meshFilename << "...\n\n";
+		WriteMesh(*outputMeshes[iMesh], meshFilename, animClips, job.GenerateCollision, job.BonePaletteSize, store, context.pCooker);
+		store.Deduplicate(meshFilename + ".ttmesh");
+
+		outputFiles.push_back(meshFilename + ".ttmesh");
+		if(job.GenerateCollision != CollisionGeneration::None)
+			outputFiles.push_back(meshFilename + ".ttcol");
+	}
+
+	//The report is an output as well, so that distributed workers send it to their coordinator
+	if(job.WriteReport){
+		pJobReport->Save(ConversionReport::GetFilename(job), job);
+		outputFiles.push_back(ConversionReport::GetFilename(job));
+
+		if(pReport)
+			*pReport = move(pJobReport);
+	}
+
+	return outputFiles;
+}
+
+//Add the nr of elements of every vertex attribute of a mesh to the report, suffix tells whether they are deduplicated
+void ReportElementCounts(const Mesh& mesh, const string& suffix)
+{
+	if(!ConversionReport::GetCurrent())
+		return;
+
+	ConversionReport::Count("Elements.Positions." + suffix, mesh.Positions.data.size());
+	ConversionReport::Count("Elements.TexCoords." + suffix, mesh.TexCoords.data.size());
+	ConversionReport::Count("Elements.Normals." + suffix, mesh.Normals.data.size());
+	ConversionReport::Count("Elements.Tangents." + suffix, mesh.Tangents.data.size());
+	ConversionReport::Count("Elements.Binormals." + suffix, mesh.Binormals.data.size());
+	ConversionReport::Count("Elements.Colors." + suffix, mesh.Colors.data.size());
+	ConversionReport::Count("Elements.BlendInfo." + suffix, mesh.BlendInformation.data.size());
+}
+
+//Add the size of a written file to the report
+void ReportFileSize(const string& name, const string& filename)
+{
+	if(!ConversionReport::GetCurrent())
+		return;
+
+	ifstream file(filename, ios::binary | ios::ate);
+	ConversionReport::Count(name, file ? static_cast<double>(file.tellg()) : 0);
+}
+
+void WriteMesh(Mesh& mesh, string outFilename, vector<AnimClip>& animClips, CollisionGeneration generateCollision, unsigned int bonePaletteSize, const ContentStore& store, PxCooking* pSharedCooker)
+{
+	std::cout << "Extracting bone transforms... ";
+	//Get bone transforms
+	StageScope sampleStage("Sample");
+	for(auto& animClip : animClips)
+		for(auto& transformAtTime : animClip.TransformsAtTimeStamps)
+			transformAtTime.second = mesh.GetBoneTransforms(transformAtTime.first);
+	sampleStage.Stop();
+
+	std::cout << "Done.\nChecking if vertices are linked to more than 4 bones... ";
+	StageScope limitStage("LimitInfluences");
+	//Make sure none of the vertices is skinned to more than 4 bones
+	mesh.LimitBoneInfluences(4);
+	limitStage.Stop();
+
+	std::cout << "Done.\nBuilding vertex- and indexbuffers... ";
+	// Construct vertexbuffer/indexBuffer, grouped into one submesh per material
+	StageScope weldStage("Weld");
+	ArenaVector<Vertex> vertexBuffer;
+	ArenaVector<unsigned int> indexBuffer;
+	ArenaVector<Submesh> submeshes;
+	BuildBuffers(mesh, vertexBuffer, indexBuffer, submeshes);
+	weldStage.Stop();
+
+	//Split draw ranges so that each of them fits in the skinning shader's bone palette
+	const bool usePalettes = bonePaletteSize > 0 && !mesh.BlendInformation.data.empty();
+	if(usePalettes){
+		std::cout << "Done.\nSplitting bone palettes... ";
+		StageScope paletteStage("SplitPalettes");
+		SplitBonePalettes(mesh, bonePaletteSize, vertexBuffer, indexBuffer, submeshes);
 	}
+	ConversionReport::Count("Triangles", indexBuffer.size() / 3);
 
 	std::cout << "Done.\nWriting mesh data... ";
+	StageScope writeStage("Write");
 	//Write a binary file containing all of the mesh & skeleton data
 
-	unsigned int version=1, nrOfUVChannels=mesh.Normals.data.empty() ?0:1, vertexFormat=0;
+	unsigned int version=2, nrOfUVChannels=mesh.TexCoords.data.empty() ?0:1, vertexFormat=GetVertexFormat(mesh);
 
-	//Build vertex format
-	vertexFormat |= mesh.Normals.data.empty()			? 0 : 1 << 0;
-	vertexFormat |= mesh.Tangents.data.empty()			? 0 : 1 << 1;
-	vertexFormat |= mesh.Binormals.data.empty()			? 0 : 1 << 2;
-	vertexFormat |= mesh.Colors.data.empty()			? 0 : 1 << 3;
-	vertexFormat |= mesh.BlendInformation.data.empty()	? 0 : 1 << 4;
+	//Palette-local blend indices are stored as bytes
+	vertexFormat |= usePalettes ? 1 << 5 : 0;
 		
 	//Create an output file
 	BinaryWriter oFile(outFilename + ".ttmesh");
 
+	//Report the size of every section of the file
+	unsigned long long sectionBegin = 0;
+	auto endSection = [&](const string& section){
+		if(!ConversionReport::GetCurrent())
+			return;
+		ConversionReport::Count("OutputBytes." + section, static_cast<double>(oFile.GetPosition() - sectionBegin));
+		sectionBegin = oFile.GetPosition();
+	};
+
 	oFile.Write<unsigned short>(version); //version number
 	oFile.Write<unsigned char>(vertexFormat); // vertex format
 	oFile.Write<unsigned char>(nrOfUVChannels); // nr of texcoord channels
@@ -265,35 +888,48 @@ void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& ani
 	
 	oFile.Write<unsigned int>(vertexBuffer.size()); // nr of vertices
 	oFile.Write<unsigned int>(indexBuffer.size()); // nr of indices
+	endSection("Header");
 
 	for(auto& elem : mesh.Positions.data) //positions
-		oFile.Write<FbxVector4>(elem);
+		oFile.Write<Float3>(elem);
+	endSection("Positions");
 	
-	for(auto& elem : mesh.TexCoords.data) //texCoords
-		oFile.Write<FbxVector2>(FbxVector2(elem.mData[0],1-elem.mData[1]));
+	for(auto& elem : mesh.TexCoords.data){ //texCoords
+		Float2 texCoord = { elem.x, 1-elem.y };
+		oFile.Write<Float2>(texCoord);
+	}
+	endSection("TexCoords");
 	
 	for(auto& elem : mesh.Normals.data) //normals
-		oFile.Write<FbxVector4>(elem);
+		oFile.Write<Float3>(elem);
+	endSection("Normals");
 
 	for(auto& elem : mesh.Tangents.data) //tangents
-		oFile.Write<FbxVector4>(elem);
+		oFile.Write<Float3>(elem);
+	endSection("Tangents");
 
 	for(auto& elem : mesh.Binormals.data) //binormals
-		oFile.Write<FbxVector4>(elem);
+		oFile.Write<Float3>(elem);
+	endSection("Binormals");
 	
 	for(auto& elem : mesh.Colors.data) //vertex colors
-		oFile.Write<FbxColor>(elem);
+		oFile.Write<Float4>(elem);
+	endSection("Colors");
 	
 	for(auto& elem : mesh.BlendInformation.data){ 
 		//blend indices
 		oFile.Write<unsigned int>(elem.BlendIndices.size() );
 		for(auto index : elem.BlendIndices)
-			oFile.Write<unsigned int>(index);
+			if(vertexFormat & 1 << 5)
+				oFile.Write<unsigned char>(index);
+			else
+				oFile.Write<unsigned int>(index);
 
 		//blend weights
 		for(auto weight : elem.BlendWeights)
-			oFile.Write<float>(static_cast<float>(weight) );
+			oFile.Write<float>(weight);
 	}
+	endSection("BlendInfo");
 
 	//Vertex buffer
 	for(auto& vertex : vertexBuffer){
@@ -311,10 +947,27 @@ void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& ani
 		if(vertexFormat & 1 << 4)
 			oFile.Write<unsigned int>(vertex.iAnimData);
 	}
+	endSection("VertexBuffer");
 
 	//Index buffer
 	for(auto index : indexBuffer)
 		oFile.Write<unsigned int>(index);
+	endSection("IndexBuffer");
+
+	//Submeshes (#, material name, first index, nr of indices, [nr of palette bones, bone indices])
+	oFile.Write<unsigned int>(submeshes.size());
+	for(auto& submesh : submeshes){
+		oFile.Write<std::string>(submesh.MaterialName);
+		oFile.Write<unsigned int>(submesh.FirstIndex);
+		oFile.Write<unsigned int>(submesh.IndexCount);
+
+		if(vertexFormat & 1 << 5){
+			oFile.Write<unsigned int>(submesh.BonePalette.size());
+			for(auto bone : submesh.BonePalette)
+				oFile.Write<unsigned int>(bone);
+		}
+	}
+	endSection("Submeshes");
 
 	std::cout << "Done.\nWriting skeleton data... ";
 	//Bones (#, names, bindposes)
@@ -323,6 +976,8 @@ void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& ani
 		oFile.Write<std::string>(bone.Name);
 		oFile.Write<FbxAMatrix>(bone.BindPose);
 	}
+	endSection("Skeleton");
+
 	std::cout << "Done.\nWriting bone animations... ";
 	//animClips (#, name, fps, nrOfKeys, keyTime0, boneTransforms0, keyTime1, boneTransforms1...)
 	oFile.Write<unsigned int>( animClips.size() );
@@ -338,6 +993,8 @@ void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& ani
 				oFile.Write<FbxAMatrix>(boneTransform);
 		}
 	}
+	endSection("Animations");
+	writeStage.Stop();
 
 	//Check if we need to generate a collision mesh
 	if(generateCollision == CollisionGeneration::None)
@@ -347,24 +1004,50 @@ void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& ani
 	}
 
 	std::cout << "Done.\nWriting PhysX data... ";
-	//Initialize cooker
-	PxCookingParams params{ PxTolerancesScale() };
-	PxCooking* pCooker = PxCreateCooking(PX_PHYSICS_VERSION, PxGetFoundation(), params);
-
+	StageScope cookStage("Cook");
 	//Build a vertex buffer for PhysX (containing only vertex positions), also copy index buffer, casting to PxU32
 
 	unsigned int nrOfVerts = mesh.Positions.data.size();
 	unsigned int nrOfIndices = mesh.Positions.indices.size();
-	PxVec3* pVertices	= new PxVec3[nrOfVerts];
-	PxU32* pIndices		= new PxU32[nrOfIndices];
+	ArenaVector<PxVec3> vertices(nrOfVerts);
+	ArenaVector<PxU32> indices(nrOfIndices);
 
 	for(unsigned int i=0; i<nrOfVerts; ++i){
 		auto pos = mesh.Positions.data[i];
-		pVertices[i] = PxVec3( static_cast<PxReal>(pos.mData[0]), static_cast<PxReal>(pos.mData[1]), static_cast<PxReal>(pos.mData[2]) );
+		vertices[i] = PxVec3(pos.x, pos.y, pos.z);
 	}
 
 	for(unsigned int i=0; i<nrOfIndices; ++i)
-		pIndices[i] = static_cast<PxU32>(mesh.Positions.indices[i]);
+		indices[i] = static_cast<PxU32>(mesh.Positions.indices[i]);
+
+	//Identical cooking input gives identical cooked data, which is taken from the content store if possible.
+	//The cooked data can't be compared with the input, so it's keyed by a 128 bit hash.
+	string colFilename = outFilename + ".ttcol";
+	WideContentHash cookingHash;
+	cookingHash.Update(static_cast<int>(generateCollision));
+	cookingHash.Update(static_cast<unsigned int>(PX_PHYSICS_VERSION));
+	cookingHash.Update(vertices.data(), vertices.size() * sizeof(PxVec3));
+	cookingHash.Update(indices.data(), indices.size() * sizeof(PxU32));
+
+	if(store.Retrieve(cookingHash.ToString(), colFilename)){
+		ReportFileSize("OutputBytes.Collision", colFilename);
+		std::cout << "Done.\n\nOperation succeeded!\n\n";
+		return;
+	}
+
+	//Cooking itself can't be interrupted, a worker pool ends the worker of a job that runs out of time
+	CancellationToken::Check();
+
+	//Initialize cooker, unless one is shared by successive conversions
+	PxCooking* pCooker = pSharedCooker;
+	if(!pCooker){
+		PxCookingParams params{ PxTolerancesScale() };
+		pCooker = PxCreateCooking(PX_PHYSICS_VERSION, PxGetFoundation(), params);
+	}
+
+	//Replace rather than overwrite, an existing file may be a hard link into the content store
+	remove(colFilename.c_str());
+	unique_ptr<UserStream> pColStream(new UserStream(colFilename.c_str(), false));
 	
 	PxTriangleMeshDesc triMeshDesc;
 	PxConvexMeshDesc convexMeshDesc;
@@ -377,10 +1060,10 @@ void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& ani
 		triMeshDesc.triangles.count		= nrOfIndices / 3;
 		triMeshDesc.points.stride		= sizeof(PxVec3);
 		triMeshDesc.triangles.stride	= 3 * sizeof(PxU32);
-		triMeshDesc.points.data			= pVertices;
-		triMeshDesc.triangles.data		= pIndices;
+		triMeshDesc.points.data			= vertices.data();
+		triMeshDesc.triangles.data		= indices.data();
 		//Cook
-		pCooker->cookTriangleMesh(triMeshDesc, UserStream((outFilename + ".ttcol").c_str(), false));
+		pCooker->cookTriangleMesh(triMeshDesc, *pColStream);
 		break;
 	case CollisionGeneration::Convex:
 		//Fill desc
@@ -388,16 +1071,83 @@ void ConvertFbxFile(string inFilename, string outFilename, vector<AnimClip>& ani
 		convexMeshDesc.triangles.count	= nrOfIndices / 3;    
 		convexMeshDesc.points.stride	= sizeof(PxVec3);    
 		convexMeshDesc.triangles.stride = 3*sizeof(PxU32);    
-		convexMeshDesc.points.data		= pVertices;
-		convexMeshDesc.triangles.data	= pIndices;    
+		convexMeshDesc.points.data		= vertices.data();
+		convexMeshDesc.triangles.data	= indices.data();    
 		convexMeshDesc.flags.set(PxConvexFlag::Enum::eCOMPUTE_CONVEX);
 		//Cook
-		pCooker->cookConvexMesh(convexMeshDesc, UserStream( (outFilename + ".ttcol").c_str(), false));
+		pCooker->cookConvexMesh(convexMeshDesc, *pColStream);
 		break;
 	};
 
 	//Stop cooking
-	pCooker->release();
+	if(!pSharedCooker)
+		pCooker->release();
+	//Close the file before storing it
+	pColStream.reset();
+	store.Store(cookingHash.ToString(), colFilename);
+	ReportFileSize("OutputBytes.Collision", colFilename);
 
 	std::cout << "Done.\n\nOperation succeeded!\n\n";
 }
+
+//Build a welded vertex buffer and an index buffer in which the triangles are grouped per material
+void BuildBuffers(const Mesh& mesh, ArenaVector<Vertex>& vertexBuffer, ArenaVector<unsigned int>& indexBuffer, ArenaVector<Submesh>& submeshes)
+{
+	//Sort triangles by material, keeping their original order within a material
+	const unsigned int nrOfTriangles = mesh.Positions.indices.size() / 3;
+	ArenaVector<unsigned int> triangleOrder(nrOfTriangles);
+	for(unsigned int iTri=0; iTri < nrOfTriangles; ++iTri)
+		triangleOrder[iTri] = iTri;
+
+	stable_sort(triangleOrder.begin(), triangleOrder.end(), [&](unsigned int lhs, unsigned int rhs){
+		return mesh.TriangleMaterials[lhs] < mesh.TriangleMaterials[rhs];
+	});
+
+	//Start a new draw range whenever the material changes
+	for(unsigned int iOrder=0; iOrder < nrOfTriangles; ++iOrder){
+		unsigned int iMaterial = mesh.TriangleMaterials[triangleOrder[iOrder]];
+
+		if(iOrder == 0 || iMaterial != mesh.TriangleMaterials[triangleOrder[iOrder-1]]){
+			Submesh newSubmesh;
+			newSubmesh.MaterialName = iMaterial < mesh.MaterialNames.size() ? mesh.MaterialNames[iMaterial] : "";
+			newSubmesh.FirstIndex = 3 * iOrder;
+			newSubmesh.IndexCount = 0;
+			submeshes.push_back(newSubmesh);
+		}
+
+		submeshes.back().IndexCount += 3;
+	}
+
+	//Vertex of a triangle corner in draw order, built on the fly so that the corners are never stored as a whole
+	auto getCorner = [&](unsigned int iCorner){
+		unsigned int i = 3 * triangleOrder[iCorner / 3] + iCorner % 3;
+
+		Vertex newVert;
+		newVert.iPosition = mesh.Positions.indices[i];
+
+		newVert.iTexCoord =		mesh.TexCoords.indices.empty()			? 0 : mesh.TexCoords.indices[i];
+		newVert.iNormal =		mesh.Normals.indices.empty()			? 0 : mesh.Normals.indices[i];
+		newVert.iTangent =		mesh.Tangents.indices.empty()			? 0 : mesh.Tangents.indices[i];
+		newVert.iBinormal =		mesh.Binormals.indices.empty()			? 0 : mesh.Binormals.indices[i];
+		newVert.iVertexColor =	mesh.Colors.indices.empty()				? 0 : mesh.Colors.indices[i];
+		newVert.iAnimData =		mesh.BlendInformation.indices.empty()	? 0 : mesh.BlendInformation.indices[i];
+		return newVert;
+	};
+
+	//Weld identical vertices, the index of every corner in the vertex buffer forms the index buffer
+	Deduplicate<Vertex>(3 * nrOfTriangles, getCorner, vertexBuffer, indexBuffer);
+	ConversionReport::Count("Elements.Vertices.Before", 3 * nrOfTriangles);
+	ConversionReport::Count("Elements.Vertices.After", vertexBuffer.size());
+}
+
+//Build vertex format
+unsigned int GetVertexFormat(const Mesh& mesh)
+{
+	unsigned int vertexFormat = 0;
+	vertexFormat |= mesh.Normals.data.empty()			? 0 : 1 << 0;
+	vertexFormat |= mesh.Tangents.data.empty()			? 0 : 1 << 1;
+	vertexFormat |= mesh.Binormals.data.empty()			? 0 : 1 << 2;
+	vertexFormat |= mesh.Colors.data.empty()			? 0 : 1 << 3;
+	vertexFormat |= mesh.BlendInformation.data.empty()	? 0 : 1 << 4;
+	return vertexFormat;
+}